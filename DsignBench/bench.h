@@ -0,0 +1,39 @@
+#pragma once
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+// Self-registering benchmarks: BENCH(name) { ... } in any file of the target, run by
+// bench_main.cpp in registration order. Each prints its own table; numbers are wall-clock
+// milliseconds, so build Release and close other programs before comparing runs.
+struct BenchCase {
+    const char* name;
+    void (*fn)();
+};
+
+std::vector<BenchCase>& benchRegistry();
+
+struct BenchRegistrar {
+    BenchRegistrar(const char* name, void (*fn)()) { benchRegistry().push_back({ name, fn }); }
+};
+
+#define BENCH(name) \
+    static void name(); \
+    static BenchRegistrar name##Registrar(#name, name); \
+    static void name()
+
+// keeps the optimizer from dropping the computation of a result nothing else reads
+extern volatile double benchSink;
+
+// best wall-clock time of fn over reps runs, in ms
+template <class F>
+double bestMs(int reps, F&& fn) {
+    double best = 1e300;
+    for (int r = 0; r < reps; ++r) {
+        auto t0 = std::chrono::steady_clock::now();
+        fn();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        if (ms < best) best = ms;
+    }
+    return best;
+}
@@ -0,0 +1,20 @@
+#include "bench.h"
+#include <cstring>
+
+std::vector<BenchCase>& benchRegistry() {
+    static std::vector<BenchCase> benches;
+    return benches;
+}
+
+volatile double benchSink = 0.0;
+
+// DsignBench [name-substring]: runs every benchmark, or those whose name contains the argument
+int main(int argc, char** argv) {
+    for (const BenchCase& b : benchRegistry()) {
+        if (argc > 1 && !std::strstr(b.name, argv[1])) continue;
+        std::printf("%s\n", b.name);
+        b.fn();
+        std::printf("\n");
+    }
+    return 0;
+}
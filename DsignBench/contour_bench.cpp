@@ -0,0 +1,56 @@
+#include "bench.h"
+#include "../DsignCalculator/core/grapher/grapher.h"
+#include "../DsignCalculator/core/optimizer/optimizer.h"
+#include "../DsignCalculator/core/parser/core_parser.h"
+#include "../DsignCalculator/core/threading/thread_pool.h"
+#include "../DsignCalculator/core/tokenizer/tokenizer.h"
+
+// Implicit relations on a 1200 x 800 screen at 30 px per unit, plotted by each ImplicitMethod
+// through computeGraphFromRPN. The evaluations come from the plotters run on their own over the
+// same window, on a 300 x 300 lattice like the grapher's: every node for the grid, interval and
+// point evaluations for the quadtree, and the nodes the tracer reads when seeded from every 4th
+// row and column, as the grapher seeds it.
+BENCH(implicitPlotters) {
+    const char* relations[] = {
+        "x^2+y^2-25",
+        "sin(x*y)-0.3",
+        "sin(x)*exp(y/5)-cos(y*x/3)",
+        "sin(x)+sin(y)-0.1",
+        "y*(y-x)*(y+x)-sin(x)",
+        "abs(y-sin(x))-0.02",
+    };
+    const char* names[] = { "grid", "quadtree", "trace" };
+    const double scale = 30.0, xMin = -20.0, xMax = 20.0, yMin = -400.0 / 30.0, yMax = 400.0 / 30.0;
+    const int nx = 300, ny = 300;
+    const double dx = (xMax - xMin) / (nx - 1), dy = (yMax - yMin) / (ny - 1);
+    ThreadPool pool;
+
+    std::printf("  %-28s %-9s %9s %11s %10s %9s\n", "relation", "method", "ms", "evaluations", "polylines", "vertices");
+    for (const char* r : relations) {
+        std::vector<Token> rpn = shuntingYard(tokenize(r));
+        Program p = optimizeProgram(compileRPN(rpn));
+        for (int m = 0; m < 3; ++m) {
+            ImplicitMethod method = (ImplicitMethod)m;
+            std::vector<std::vector<sf::Vertex>> lines;
+            double ms = bestMs(5, [&] {
+                lines = computeGraphFromRPN(rpn, sf::Color::Cyan, scale, xMin, xMax, 600.0, 400.0, 1200, 800, nullptr,
+                    nullptr, &pool, std::chrono::steady_clock::time_point::max(), nullptr, method);
+            });
+            size_t evaluations = (size_t)nx * ny;
+            if (method == ImplicitMethod::Quadtree) {
+                ImplicitQuadtree tree(p, {}, xMin, xMax, yMin, yMax, scale);
+                tree.refine(QUADTREE_LEAF_PX, &pool);
+                tree.contour(&pool);
+                evaluations = tree.intervalEvaluations() + tree.pointEvaluations();
+            }
+            else if (method == ImplicitMethod::Trace) {
+                ContourTracer tracer(p, {}, -nx / 2, -ny / 2, dx, dy, nx, ny);
+                tracer.trace(4);
+                evaluations = tracer.evaluations();
+            }
+            size_t vertices = 0;
+            for (const auto& line : lines) vertices += line.size();
+            std::printf("  %-28s %-9s %9.2f %11zu %10zu %9zu\n", r, names[m], ms, evaluations, lines.size(), vertices);
+        }
+    }
+}
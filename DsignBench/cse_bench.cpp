@@ -0,0 +1,37 @@
+#include "bench.h"
+#include "../DsignCalculator/core/compiler/compiler.h"
+#include "../DsignCalculator/core/optimizer/expr_graph.h"
+#include "../DsignCalculator/core/parser/core_parser.h"
+#include "../DsignCalculator/core/tokenizer/tokenizer.h"
+
+// Common subexpressions in typical plots: the tree compileRPN produces, one node per instruction,
+// against the nodes left once buildExprGraph has interned it, and the temp slots lowerExprGraph
+// stores the shared ones in. Nothing is folded first, so only interning removes nodes.
+BENCH(commonSubexpressions) {
+    const char* expressions[] = {
+        "sqrt(x^2+y^2)+sin(sqrt(x^2+y^2))",
+        "(x^2+y^2)^2-4*(x^2-y^2)",
+        "(x-1)*(x-1)+(y-1)*(y-1)-(x-1)*(y-1)",
+        "exp(-x^2)*cos(5*x)+exp(-x^2)*sin(5*x)",
+        "sin(x)^2+cos(x)^2+sin(x)*cos(x)",
+        "(x^2+y^2-1)^3-x^2*y^3",
+        "x*y*sin(x*y)-cos(x*y)",
+        "sin(x*y)-0.3",
+        "a*sin(b*x)+a*cos(b*x)",
+        "tan(x)/(1+tan(x)^2)",
+        "abs(x-y)+abs(y-x)+x*y",
+        "x^3-3*x*y^2-1",
+    };
+
+    std::printf("  %-42s %7s %9s %6s\n", "expression", "nodes", "interned", "temps");
+    size_t totalNodes = 0, totalInterned = 0;
+    for (const char* e : expressions) {
+        Program p = compileRPN(shuntingYard(tokenize(e)));
+        ExprGraph g = buildExprGraph(p);
+        Program lowered = lowerExprGraph(g);
+        totalNodes += p.code.size();
+        totalInterned += g.nodes.size();
+        std::printf("  %-42s %7zu %9zu %6d\n", e, p.code.size(), g.nodes.size(), lowered.tempCount);
+    }
+    std::printf("  %-42s %7zu %9zu\n", "total", totalNodes, totalInterned);
+}
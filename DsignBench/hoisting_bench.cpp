@@ -0,0 +1,55 @@
+#include "bench.h"
+#include "../DsignCalculator/core/evaluator/evaluator.h"
+#include "../DsignCalculator/core/jit/jit.h"
+#include "../DsignCalculator/core/optimizer/hoisting.h"
+#include "../DsignCalculator/core/optimizer/optimizer.h"
+#include "../DsignCalculator/core/parser/core_parser.h"
+#include "../DsignCalculator/core/tokenizer/tokenizer.h"
+#include <string>
+#include <unordered_map>
+
+// Parameter-heavy expressions before and after hoistInvariants, on the evaluator the grapher would
+// pick for each (jitPreferred). The parameters stay unbound while optimizing, as while a slider is
+// being dragged, so nothing folds and only hoisting removes the parameter-only work.
+static double batchMs(const Program& p, const std::vector<double>& xs, const std::vector<double>& ys, const double* vars,
+    std::vector<double>& out) {
+    JitProgram jit;
+    bool useJit = jitPreferred(p);
+    if (useJit) jit = compileJit(p);
+    return bestMs(10, [&] {
+        if (useJit) jit.evaluateBatch(xs.data(), ys.data(), vars, out.data(), xs.size());
+        else evaluateProgramBatch(p, xs.data(), ys.data(), vars, out.data(), xs.size());
+        benchSink = out[xs.size() / 2];
+    });
+}
+
+BENCH(hoistedInvariants) {
+    const char* expressions[] = {
+        "a*sin(b)*x",
+        "a*sin(b)*x+c*cos(b*c)*x^2",
+        "sqrt(a^2+b^2)*sin(k*x+atan(b/a))",
+        "exp(-b*c)*x^3+log(a+c)*x-sin(a)*cos(c)",
+        "(x-a*cos(b))^2+(y-a*sin(b))^2-c^2",
+    };
+    const size_t n = 200000;
+    std::unordered_map<std::string, double> env = { { "a", 1.7 }, { "b", 0.6 }, { "c", 2.2 }, { "k", 3.0 } };
+    std::vector<double> xs(n), ys(n), out(n);
+    for (size_t i = 0; i < n; ++i) {
+        xs[i] = -10.0 + 20.0 * (double)i / (double)n;
+        ys[i] = 3.0 - 6.0 * (double)i / (double)n;
+    }
+
+    std::printf("  %-42s %13s %10s %10s\n", "expression (200k samples)", "instructions", "plain ms", "hoisted ms");
+    for (const char* e : expressions) {
+        Program p = optimizeProgram(compileRPN(shuntingYard(tokenize(e))));
+        HoistedProgram h = hoistInvariants(p);
+        std::vector<double> plainVars = bindVariables(p, &env), hoistedVars = bindVariables(h.body, &env);
+        evaluateInvariants(h, hoistedVars);
+
+        double plain = batchMs(p, xs, ys, plainVars.data(), out);
+        double hoisted = batchMs(h.body, xs, ys, hoistedVars.data(), out);
+        char sizes[32];
+        std::snprintf(sizes, sizeof sizes, "%zu -> %zu", p.code.size(), h.body.code.size());
+        std::printf("  %-42s %13s %10.2f %10.2f\n", e, sizes, plain, hoisted);
+    }
+}
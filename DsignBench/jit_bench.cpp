@@ -0,0 +1,61 @@
+#include "bench.h"
+#include "../DsignCalculator/core/evaluator/evaluator.h"
+#include "../DsignCalculator/core/jit/jit.h"
+#include "../DsignCalculator/core/optimizer/optimizer.h"
+#include "../DsignCalculator/core/parser/core_parser.h"
+#include "../DsignCalculator/core/tokenizer/tokenizer.h"
+#include <string>
+#include <unordered_map>
+
+// The evaluation paths of one curve's worth of samples, slowest first: evaluateRPNVec (compiles
+// the RPN on every call), then on the optimized Program as the grapher runs it: evaluateProgram
+// per sample, the SIMD batch interpreter, and the JIT. jitPreferred tells which of the last two
+// the grapher picks.
+BENCH(jitVersusInterpreters) {
+    const char* expressions[] = {
+        "x^2+3*x-1/x",
+        "a*x*x*x+b*x*x-x/2+1",
+        "((x+1)*(x-2)+3)*((x-4)*(x+5)-6)/(x*x+7)",
+        "sin(x)*x^2+3*x-cos(x)/2",
+        "exp(-x*x)*atan(x)",
+    };
+    const size_t n = 200000;
+    std::unordered_map<std::string, double> env = { { "a", 1.5 }, { "b", -2.0 } };
+    std::vector<double> xs(n), out(n);
+    for (size_t i = 0; i < n; ++i) xs[i] = -100.0 + 200.0 * (double)i / (double)n;
+
+    std::printf("  %-42s %9s %9s %9s %9s %7s\n", "expression (200k samples, ms)", "rpnVec", "program", "batch", "jit", "picks");
+    for (const char* e : expressions) {
+        std::vector<Token> rpn = shuntingYard(tokenize(e));
+        Program p = optimizeProgram(compileRPN(rpn));
+        std::vector<double> vars = bindVariables(p, &env);
+        JitProgram jit = compileJit(p);
+
+        // evaluateRPNVec has no variables, so it only runs on the expressions that need none
+        double rpnMs = -1.0;
+        if (p.variables.empty()) {
+            rpnMs = bestMs(1, [&] {
+                double s = 0.0;
+                for (double x : xs) s += evaluateRPNVec(rpn, x);
+                benchSink = s;
+            });
+        }
+        double programMs = bestMs(3, [&] {
+            double s = 0.0;
+            for (double x : xs) s += evaluateProgram(p, x, 0.0, vars.data());
+            benchSink = s;
+        });
+        double batchMs = bestMs(5, [&] {
+            evaluateProgramBatch(p, xs.data(), nullptr, vars.data(), out.data(), n);
+            benchSink = out[n / 2];
+        });
+        double jitMs = bestMs(5, [&] {
+            jit.evaluateBatch(xs.data(), nullptr, vars.data(), out.data(), n);
+            benchSink = out[n / 2];
+        });
+        char rpnText[16] = "-";
+        if (rpnMs >= 0.0) std::snprintf(rpnText, sizeof rpnText, "%.2f", rpnMs);
+        std::printf("  %-42s %9s %9.2f %9.2f %9.2f %7s\n", e, rpnText, programMs, batchMs, jitMs,
+            !jit.isNative() ? "interp" : jitPreferred(p) ? "jit" : "batch");
+    }
+}
@@ -0,0 +1,74 @@
+#include "bench.h"
+#include "../DsignCalculator/core/grapher/grapher.h"
+#include "../DsignCalculator/core/parser/core_parser.h"
+#include "../DsignCalculator/core/threading/thread_pool.h"
+#include "../DsignCalculator/core/tokenizer/tokenizer.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+// A screen's worth of explicit and implicit curves computed on ThreadPools of 1..N threads, N the
+// hardware concurrency. The curves are spread over the pool the way the graph service does it,
+// each of them splitting its own work further, and every thread count must draw the same vertices.
+static uint64_t hashVertices(const std::vector<std::vector<std::vector<sf::Vertex>>>& graphs, size_t& count) {
+    uint64_t h = 1469598103934665603ull;
+    auto mix = [&](uint32_t v) { h = (h ^ v) * 1099511628211ull; };
+    count = 0;
+    for (const auto& graph : graphs) {
+        for (const auto& line : graph) {
+            for (const sf::Vertex& v : line) {
+                uint32_t bits[2];
+                std::memcpy(&bits[0], &v.position.x, 4);
+                std::memcpy(&bits[1], &v.position.y, 4);
+                mix(bits[0]);
+                mix(bits[1]);
+                ++count;
+            }
+            mix(0xff);
+        }
+        mix(0xabc);
+    }
+    return h;
+}
+
+BENCH(threadPoolScaling) {
+    const char* expressions[] = {
+        "x^2", "sin(x)*a", "(x^2+y^2)-(25)", "(sin(x))-(cos(y))", "1/x", "tan(x)", "(y)-(x^3-b)", "sqrt(x)",
+        "(sin(x*y))-(0.3)", "(x^2-y^2)-(sin(x)*cos(y))", "100*sin(1/x)", "(y^2)-(x^3-x)",
+    };
+    std::unordered_map<std::string, double> env = { { "a", 2.0 }, { "b", 0.5 } };
+    std::vector<std::vector<Token>> rpns;
+    for (const char* e : expressions) rpns.push_back(shuntingYard(tokenize(e)));
+
+    const size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    double oneThreadMs = 0.0;
+    uint64_t reference = 0;
+    std::printf("  %7s %10s %8s %9s\n", "threads", "ms", "speedup", "vertices");
+    for (size_t threads = 1; threads <= maxThreads; ++threads) {
+        ThreadPool pool(threads);
+        std::vector<std::vector<std::vector<sf::Vertex>>> graphs(rpns.size());
+        auto computeAll = [&] {
+            TaskGroup group(&pool);
+            for (size_t i = 0; i < rpns.size(); ++i) {
+                group.run([&, i] {
+                    graphs[i] = computeGraphFromRPN(rpns[i], sf::Color::Cyan, 20.0, -30.0, 30.0, 600.0, 400.0, 1200, 800,
+                        &env, nullptr, &pool);
+                });
+            }
+            group.wait();
+        };
+        computeAll();  // warm-up
+        double ms = bestMs(3, computeAll);
+        size_t vertices = 0;
+        uint64_t h = hashVertices(graphs, vertices);
+        if (threads == 1) {
+            oneThreadMs = ms;
+            reference = h;
+        }
+        std::printf("  %7zu %10.2f %7.2fx %9zu%s\n", threads, ms, oneThreadMs / ms, vertices,
+            h == reference ? "" : "  (output differs from 1 thread)");
+    }
+}
@@ -1,7 +1,10 @@
 ﻿#include <SFML/Graphics.hpp>
 #include <SFML/Window/Clipboard.hpp>
 #include "../core/grapher/grapher.h"
+#include "../core/grapher/graph_service.h"
+#include "../core/compiler/compiler.h"
 #include "../core/parser/core_parser.h"
+#include "../core/threading/thread_pool.h"
 #include <iostream>
 #include <string>
 #include <vector>
@@ -108,11 +111,13 @@ int main() {
     const float sidebarPadding = 10.f;
 
     std::vector<std::string> currentInput;
-    std::vector<std::vector<std::vector<sf::Vertex>>> lastGraph;
     std::vector<std::string> lastExpr;
     std::vector<std::vector<Token>> lastRPN;
-    std::vector<double> lastCenterX;
-    std::vector<double> lastCenterY;
+    // what an entry showed before Enter, kept until the first finished frame of generation
+    // previousUntil or later tells whether the new expression plots anything (0: nothing pending)
+    std::vector<std::string> previousExpr;
+    std::vector<std::vector<Token>> previousRPN;
+    std::vector<uint64_t> previousUntil;
     std::vector<sf::Color> colors;
     std::vector<sf::Text> inputTexts;
 
@@ -134,11 +139,11 @@ int main() {
         if ((int)currentInput.size() >= MAX_INPUTS) return;
         int i = (int)currentInput.size();
         currentInput.push_back(initText);
-        lastGraph.emplace_back();
         lastExpr.emplace_back();
         lastRPN.emplace_back();
-        lastCenterX.push_back(0.0);
-        lastCenterY.push_back(0.0);
+        previousExpr.emplace_back();
+        previousRPN.emplace_back();
+        previousUntil.push_back(0);
         colors.push_back(palette[i % (int)palette.size()]);
         sf::Text t;
         t.setFont(font);
@@ -163,32 +168,31 @@ int main() {
     double scale = 5.0;
     const double MIN_SCALE = 1.0;   
     const double MAX_SCALE = 4000.0; 
-    auto computeAdaptiveStep = [](double s) {
-        return std::max(0.001, 1.0 / s * 0.5);
-    };
 
 
+    ThreadPool graphPool;
+    GraphService graphService(&graphPool);
+    ImplicitMethod implicitMethod = ImplicitMethod::Grid;  // F2 cycles it
+    std::shared_ptr<const GraphFrame> shownFrame;
+    auto currentView = [&](double centerX, double centerY) {
+        GraphView v;
+        v.scale = scale;
+        v.centerX = centerX;
+        v.centerY = centerY;
+        v.screenWidth = (int)(window.getSize().x - (int)sidebarWidth);
+        v.screenHeight = window.getSize().y;
+        return v;
+    };
+    // hands the graphs to the background service; the frame on screen stays until the new one is ready
     auto computeAllGraphs = [&](double centerX, double centerY) {
-        double step = computeAdaptiveStep(scale);
-        int graphW = (int)(window.getSize().x - (int)sidebarWidth);
-        int screenW = graphW;
-        int screenH = window.getSize().y;
-
-        double xMin = (0.0 - centerX) / scale;
-        double xMax = ((double)screenW - centerX) / scale;
-
-
-        size_t n = std::max(lastRPN.size(), currentInput.size());
-        if (lastGraph.size() < n) lastGraph.resize(n);
-        if (lastCenterX.size() < n) lastCenterX.resize(n, centerX);
-        if (lastCenterY.size() < n) lastCenterY.resize(n, centerY);
-
-        for (size_t i = 0; i < lastRPN.size(); ++i) {
-            if (lastRPN[i].empty()) { lastGraph[i].clear(); continue; }
-            lastGraph[i] = computeGraphFromRPN(lastRPN[i], colors[i % colors.size()], scale, xMin, xMax, step, centerX, centerY, screenW, screenH, &env);
-            lastCenterX[i] = centerX;
-            lastCenterY[i] = centerY;
-        }
+        GraphJob job;
+        job.view = currentView(centerX, centerY);
+        job.rpn = lastRPN;
+        for (size_t i = 0; i < lastRPN.size(); ++i) job.colors.push_back(colors[i % colors.size()]);
+        job.fallback = previousRPN;
+        job.env = env;
+        job.implicit = implicitMethod;
+        return graphService.post(std::move(job));
     };
 
     bool dragging = false;
@@ -359,6 +363,16 @@ int main() {
                     active = (active + 1) % (int)currentInput.size();
                     needRedraw = true;
                 }
+                if (event.key.code == sf::Keyboard::F2) {
+                    static const char* const methodNames[] = { "grid", "quadtree", "trace" };
+                    implicitMethod = (ImplicitMethod)(((int)implicitMethod + 1) % 3);
+                    std::cerr << "Implicit relations plotted by " << methodNames[(int)implicitMethod] << ".\n";
+                    int graphW = window.getSize().x - (int)sidebarWidth;
+                    float centerX = graphW / 2.0f + (float)panX;
+                    float centerY = (float)window.getSize().y / 2.0f + (float)panY;
+                    computeAllGraphs(centerX, centerY);
+                    needRedraw = true;
+                }
             }
 
             if (event.type == sf::Event::TextEntered) {
@@ -394,28 +408,23 @@ int main() {
                     int graphH = window.getSize().y;
                     float centerX = graphW / 2.0f + panX;
                     float centerY = graphH / 2.0f + panY;
-                    double xRange = (graphW / 2.0) / scale;
-                    double xMin = -xRange;
-                    double xMax = xRange;
-                    double step = computeAdaptiveStep(scale);
 
                     try {
                         std::string expr = normalizeExpression(currentInput[active]);
                         auto tokens = tokenize(expr);
                         auto rpn = shuntingYard(tokens);
-                        auto graph = computeGraphFromRPN(rpn, colors[active], scale, xMin, xMax, step, centerX, centerY, graphW, graphH, &env);
-                        if (!graph.empty()) {
-                            lastGraph[active] = std::move(graph);
-                            lastExpr[active] = currentInput[active];
-                            lastRPN[active] = std::move(rpn);
-                            lastCenterX[active] = centerX;
-                            lastCenterY[active] = centerY;
-                        } else {
-                            std::cerr << "Expression produced no points or was invalid for input " << (active+1) << ". Keeping previous graph.\n";
+                        compileRPN(rpn);
+                        if (!previousUntil[active]) {
+                            previousExpr[active] = lastExpr[active];
+                            previousRPN[active] = lastRPN[active];
                         }
+                        lastExpr[active] = currentInput[active];
+                        lastRPN[active] = std::move(rpn);
+                        uint64_t generation = computeAllGraphs(centerX, centerY);
+                        previousUntil[active] = previousRPN[active].empty() ? 0 : generation;
                     }
                     catch (...) {
-                        std::cerr << "Parse/eval error for input " << (active+1) << "\n";
+                        std::cerr << "Parse/eval error for input " << (active+1) << ". Keeping previous graph.\n";
                     }
 
                     needRedraw = true;
@@ -443,6 +452,23 @@ int main() {
             pendingComputeAfterDrag = false; needRedraw = true;
         }
 
+        auto newestFrame = graphService.latest();
+        if (newestFrame != shownFrame) {
+            shownFrame = std::move(newestFrame);
+            needRedraw = true;
+            for (size_t i = 0; i < previousUntil.size() && shownFrame->complete; ++i) {
+                if (!previousUntil[i] || shownFrame->generation < previousUntil[i]) continue;
+                if (i < shownFrame->fellBack.size() && shownFrame->fellBack[i]) {
+                    std::cerr << "Expression produced no points for input " << (i+1) << ". Keeping previous graph.\n";
+                    lastExpr[i] = std::move(previousExpr[i]);
+                    lastRPN[i] = std::move(previousRPN[i]);
+                }
+                previousExpr[i].clear();
+                previousRPN[i].clear();
+                previousUntil[i] = 0;
+            }
+        }
+
         if (!needRedraw) {
             sf::sleep(sf::milliseconds(10));
             continue;
@@ -512,16 +538,14 @@ int main() {
         }
 
 
-        for (size_t i = 0; i < lastGraph.size(); ++i) {
-            if (lastGraph[i].empty()) continue;
-            float dx = (float)(centerX - lastCenterX[i]);
-            float dy = (float)(centerY - lastCenterY[i]);
+        if (shownFrame) {
             sf::RenderStates states;
-            states.transform.translate(dx, dy);
-            
-            for (const auto &seg : lastGraph[i]) {
-                if (seg.size() < 2) continue;
-                window.draw(seg.data(), seg.size(), sf::LineStrip, states);
+            states.transform = viewCorrection(shownFrame->view, currentView(centerX, centerY));
+            for (const auto &graph : shownFrame->graphs) {
+                for (const auto &seg : graph) {
+                    if (seg.size() < 2) continue;
+                    window.draw(seg.data(), seg.size(), sf::LineStrip, states);
+                }
             }
         }
 
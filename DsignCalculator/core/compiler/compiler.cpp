@@ -0,0 +1,121 @@
+#include "compiler.h"
+#include <map>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+static const std::map<std::string, OpCode> operator_opcodes = {
+    {"+", OpCode::Add}, {"-", OpCode::Sub},
+    {"*", OpCode::Mul}, {"/", OpCode::Div},
+    {"^", OpCode::Pow}
+};
+
+static const std::map<std::string, OpCode> function_opcodes = {
+    {"sin", OpCode::Sin}, {"cos", OpCode::Cos}, {"tan", OpCode::Tan},
+    {"asin", OpCode::Asin}, {"arcsin", OpCode::Asin},
+    {"acos", OpCode::Acos}, {"arccos", OpCode::Acos},
+    {"atan", OpCode::Atan}, {"arctan", OpCode::Atan},
+    {"sqrt", OpCode::Sqrt}, {"log", OpCode::Log}, {"ln", OpCode::Log},
+    {"exp", OpCode::Exp}, {"neg", OpCode::Neg}, {"abs", OpCode::Abs},
+    {"pow", OpCode::Pow}
+};
+
+static int variableSlot(Program& p, const std::string& name) {
+    auto it = std::find(p.variables.begin(), p.variables.end(), name);
+    if (it != p.variables.end()) return (int)(it - p.variables.begin());
+    p.variables.push_back(name);
+    return (int)p.variables.size() - 1;
+}
+
+Program compileRPN(const std::vector<Token>& rpn) {
+    Program p;
+    p.code.reserve(rpn.size());
+    int depth = 0;
+
+    auto push = [&](const Instr& in, int pops) {
+        if (depth < pops) throw std::runtime_error("Invalid expression");
+        depth = depth - pops + 1;
+        if (depth > PROGRAM_MAX_STACK) throw std::runtime_error("Expression too deep");
+        p.maxStack = std::max(p.maxStack, depth);
+        p.code.push_back(in);
+    };
+
+    for (const Token& t : rpn) {
+        Instr in;
+        switch (t.type) {
+        case TokenType::Number:
+            in.op = OpCode::Const;
+            in.value = t.number;
+            push(in, 0);
+            break;
+
+        case TokenType::Variable:
+            if (t.text == "x") { in.op = OpCode::LoadX; p.usesX = true; }
+            else if (t.text == "y") { in.op = OpCode::LoadY; p.usesY = true; }
+            else { in.op = OpCode::LoadVar; in.slot = variableSlot(p, t.text); }
+            push(in, 0);
+            break;
+
+        case TokenType::Operator: {
+            auto it = operator_opcodes.find(t.text);
+            if (it == operator_opcodes.end()) throw std::runtime_error("Unknown operator " + t.text);
+            in.op = it->second;
+            push(in, 2);
+            break;
+        }
+
+        case TokenType::Function: {
+            auto it = function_opcodes.find(t.text);
+            if (it == function_opcodes.end()) throw std::runtime_error("Unknown function " + t.text);
+            in.op = it->second;
+            push(in, t.arity);
+            break;
+        }
+
+        default:
+            break;
+        }
+    }
+
+    if (depth != 1) throw std::runtime_error("Invalid evaluation");
+    return p;
+}
+
+std::vector<double> bindVariables(const Program& p, const std::unordered_map<std::string, double>* env) {
+    std::vector<double> frame(p.variables.size(), 0.0);
+    if (!env) return frame;
+    for (size_t i = 0; i < p.variables.size(); ++i) {
+        auto it = env->find(p.variables[i]);
+        if (it != env->end()) frame[i] = it->second;
+    }
+    return frame;
+}
+
+static uint64_t mixHash(uint64_t h, uint64_t v) {
+    h = (h ^ v) * 0x9E3779B97F4A7C15ull;
+    return h ^ (h >> 29);
+}
+
+uint64_t programHash(const Program& p) {
+    uint64_t h = 0;
+    for (const Instr& in : p.code) {
+        uint64_t bits;
+        std::memcpy(&bits, &in.value, sizeof bits);
+        h = mixHash(h, (uint64_t)in.op);
+        h = mixHash(h, (uint32_t)in.slot);
+        h = mixHash(h, bits);
+    }
+    for (const std::string& name : p.variables) h = mixHash(h, std::hash<std::string>()(name));
+    return h;
+}
+
+uint64_t frameHash(const std::vector<double>& frame) {
+    uint64_t h = frame.size();
+    for (double v : frame) {
+        uint64_t bits;
+        std::memcpy(&bits, &v, sizeof bits);
+        h = mixHash(h, bits);
+    }
+    return h;
+}
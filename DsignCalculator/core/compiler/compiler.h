@@ -0,0 +1,71 @@
+#pragma once
+#include "../tokenizer/tokenizer.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// grouped as loads, binary operators, unary functions; evaluateProgramBatch relies on the order
+enum class OpCode : uint8_t {
+    Const,
+    LoadX,
+    LoadY,
+    LoadVar,
+    LoadColumn,
+    LoadTemp,
+    Add,
+    Sub,
+    Mul,
+    Div,
+    Pow,
+    Neg,
+    Sin,
+    Cos,
+    Tan,
+    Asin,
+    Acos,
+    Atan,
+    Sqrt,
+    Log,
+    Exp,
+    Abs,
+    PowI,
+    StoreTemp
+};
+
+inline int opArity(OpCode op) {
+    if (op <= OpCode::LoadTemp) return 0;
+    if (op <= OpCode::Pow) return 2;
+    return 1;
+}
+
+struct Instr {
+    OpCode op;
+    int32_t slot = 0;    // LoadVar: index into Program::variables, LoadColumn: input column, PowI: integer exponent, Load/StoreTemp: temp index
+    double value = 0.0;  // Const: pre-resolved number
+};
+
+// fixed capacity of the interpreter value stack; deeper expressions are rejected by compileRPN
+constexpr int PROGRAM_MAX_STACK = 64;
+// fixed capacity of the temp slots holding shared subexpressions (StoreTemp keeps the value on the stack)
+constexpr int PROGRAM_MAX_TEMPS = 64;
+
+struct Program {
+    std::vector<Instr> code;
+    std::vector<std::string> variables;
+    int maxStack = 0;
+    int tempCount = 0;
+    int columnCount = 0;  // per-sample input columns read by LoadColumn, besides x and y
+    bool usesX = false;
+    bool usesY = false;
+};
+
+Program compileRPN(const std::vector<Token>& rpn);
+
+// Flat binding frame indexed by LoadVar slot; names missing from env (or a null env) read as 0.
+std::vector<double> bindVariables(const Program& p, const std::unordered_map<std::string, double>* env);
+
+// Hashes of a program's code and variable names, and of a bound frame. Together they identify the
+// function a program computes, for caching its results.
+uint64_t programHash(const Program& p);
+uint64_t frameHash(const std::vector<double>& frame);
@@ -0,0 +1,44 @@
+#pragma once
+#include <cmath>
+
+// Forward-mode dual number: v is the value, d the derivative along the seeded input.
+// Evaluating with x = Dual(x0, 1) gives f(x0) and f'(x0) in one pass.
+struct Dual {
+    double v = 0.0;
+    double d = 0.0;
+
+    Dual() = default;
+    Dual(double value) : v(value) {}
+    Dual(double value, double deriv) : v(value), d(deriv) {}
+};
+
+inline Dual operator+(Dual a, Dual b) { return { a.v + b.v, a.d + b.d }; }
+inline Dual operator-(Dual a, Dual b) { return { a.v - b.v, a.d - b.d }; }
+inline Dual operator-(Dual a) { return { -a.v, -a.d }; }
+inline Dual operator*(Dual a, Dual b) { return { a.v * b.v, a.d * b.v + a.v * b.d }; }
+inline Dual operator/(Dual a, Dual b) { return { a.v / b.v, (a.d * b.v - a.v * b.d) / (b.v * b.v) }; }
+
+inline Dual sin(Dual a) { return { std::sin(a.v), std::cos(a.v) * a.d }; }
+inline Dual cos(Dual a) { return { std::cos(a.v), -std::sin(a.v) * a.d }; }
+inline Dual tan(Dual a) { double t = std::tan(a.v); return { t, (1.0 + t * t) * a.d }; }
+inline Dual asin(Dual a) { return { std::asin(a.v), a.d / std::sqrt(1.0 - a.v * a.v) }; }
+inline Dual acos(Dual a) { return { std::acos(a.v), -a.d / std::sqrt(1.0 - a.v * a.v) }; }
+inline Dual atan(Dual a) { return { std::atan(a.v), a.d / (1.0 + a.v * a.v) }; }
+inline Dual sqrt(Dual a) { double s = std::sqrt(a.v); return { s, a.d / (2.0 * s) }; }
+inline Dual log(Dual a) { return { std::log(a.v), a.d / a.v }; }
+inline Dual exp(Dual a) { double e = std::exp(a.v); return { e, e * a.d }; }
+inline Dual abs(Dual a) { return { std::fabs(a.v), a.v < 0.0 ? -a.d : a.d }; }
+
+inline Dual powi(Dual a, int n) {
+    if (n == 0) return { 1.0, 0.0 };
+    double p = std::pow(a.v, n - 1);
+    return { p * a.v, n * p * a.d };
+}
+
+inline Dual pow(Dual a, Dual b) {
+    double r = std::pow(a.v, b.v);
+    // the log term only matters when the exponent varies, and would be NaN for negative bases
+    double d = b.v * std::pow(a.v, b.v - 1.0) * a.d;
+    if (b.d != 0.0) d += r * std::log(a.v) * b.d;
+    return { r, d };
+}
@@ -1,173 +1,228 @@
 #pragma once
 #include "../tokenizer/tokenizer.h"
-#include <queue>
-#include <map>
-#include <stack>
+#include "../compiler/compiler.h"
+#include "vecmath.h"
+#include "interval.h"
+#include "dual.h"
 #include <cmath>
-#include <stdexcept>
 #include <unordered_map>
 #include <string>
+#include <vector>
+#include <algorithm>
 
-inline double evaluateRPNVec(const std::vector<Token>& rpn, double xValue) {
-    std::stack<double> st;
-
-    for (const Token& t : rpn) {
-        if (t.type == TokenType::Number) {
-            st.push(t.number);
-        }
-        else if (t.type == TokenType::Variable) {
-            if (t.text == "x") st.push(xValue);
-            else st.push(0.0);
-        }
-        else if (t.type == TokenType::Operator) {
-            if (st.size() < 2) throw std::runtime_error("Invalid expression");
-            double b = st.top(); st.pop();
-            double a = st.top(); st.pop();
-            if (t.text == "+") st.push(a + b);
-            else if (t.text == "-") st.push(a - b);
-            else if (t.text == "*") st.push(a * b);
-            else if (t.text == "/") st.push(a / b);
-            else if (t.text == "^") st.push(std::pow(a, b));
-        }
-        else if (t.type == TokenType::Function) {
-            if (st.size() < (size_t)t.arity) throw std::runtime_error("Function args");
-
-            double result = 0;
-            if (t.arity == 1) {
-                double a = st.top(); st.pop();
-                if (t.text == "sin") result = std::sin(a);
-                else if (t.text == "cos") result = std::cos(a);
-                else if (t.text == "tan") result = std::tan(a);
-                else if (t.text == "arcsin" || t.text == "asin") result = std::asin(a);
-                else if (t.text == "arccos" || t.text == "acos") result = std::acos(a);
-                else if (t.text == "arctan" || t.text == "atan") result = std::atan(a);
-                else if (t.text == "sqrt") result = std::sqrt(a);
-                else if (t.text == "log" || t.text == "ln") result = std::log(a);
-                else if (t.text == "exp") result = std::exp(a);
-                else if (t.text == "neg") result = -a;
-                else if (t.text == "abs") result = std::fabs(a);
-                else result = std::nan("1");
-            }
-            else if (t.arity == 2) {
-                double b = st.top(); st.pop();
-                double a = st.top(); st.pop();
-                if (t.text == "pow") result = std::pow(a, b);
-                else result = std::nan("1");
-            }
-            st.push(result);
-        }
+// x^n as a left-to-right square-and-multiply chain; the JIT emits the same sequence
+template <class T>
+inline T powi(T x, int n) {
+    unsigned e = n < 0 ? 0u - (unsigned)n : (unsigned)n;
+    if (e == 0) return T(1.0);
+    int bit = 31;
+    while (!((e >> bit) & 1u)) --bit;
+    T r = x;
+    while (--bit >= 0) {
+        r = r * r;
+        if ((e >> bit) & 1u) r = r * x;
     }
+    return n < 0 ? T(1.0) / r : r;
+}
 
-    if (st.size() != 1) throw std::runtime_error("Invalid evaluation");
-    return st.top();
+// single-instruction semantics shared by the interpreters and the constant folder
+inline double evaluateOp(OpCode op, double a, double b, int32_t imm) {
+    switch (op) {
+    case OpCode::Add: return a + b;
+    case OpCode::Sub: return a - b;
+    case OpCode::Mul: return a * b;
+    case OpCode::Div: return a / b;
+    case OpCode::Pow: return std::pow(a, b);
+    case OpCode::Neg: return -a;
+    case OpCode::Sin: return std::sin(a);
+    case OpCode::Cos: return std::cos(a);
+    case OpCode::Tan: return std::tan(a);
+    case OpCode::Asin: return std::asin(a);
+    case OpCode::Acos: return std::acos(a);
+    case OpCode::Atan: return std::atan(a);
+    case OpCode::Sqrt: return std::sqrt(a);
+    case OpCode::Log: return std::log(a);
+    case OpCode::Exp: return std::exp(a);
+    case OpCode::Abs: return std::fabs(a);
+    case OpCode::PowI: return powi(a, imm);
+    default: return std::nan("1");
+    }
 }
 
-inline double evaluateRPNXY(const std::vector<Token>& rpn, double xValue, double yValue) {
-    std::stack<double> st;
+// Binding policies deciding what LoadX / LoadY / LoadVar read. They are template parameters of
+// evaluate(), so each specialization is straight-line code with no checks on how variables are bound.
+template <class T>
+struct BindX {
+    T x;
+    T loadX() const { return x; }
+    T loadY() const { return T(0.0); }
+    T loadVar(int) const { return T(0.0); }
+    T loadColumn(int) const { return T(0.0); }
+};
 
-    for (const Token& t : rpn) {
-        if (t.type == TokenType::Number) {
-            st.push(t.number);
-        }
-        else if (t.type == TokenType::Variable) {
-            if (t.text == "x") st.push(xValue);
-            else if (t.text == "y") st.push(yValue);
-            else /* unknown variable -> 0 */ st.push(0.0);
-        }
-        else if (t.type == TokenType::Operator) {
-            if (st.size() < 2) throw std::runtime_error("Invalid expression");
-            double b = st.top(); st.pop();
-            double a = st.top(); st.pop();
-            if (t.text == "+") st.push(a + b);
-            else if (t.text == "-") st.push(a - b);
-            else if (t.text == "*") st.push(a * b);
-            else if (t.text == "/") st.push(a / b);
-            else if (t.text == "^") st.push(std::pow(a, b));
-        }
-        else if (t.type == TokenType::Function) {
-            if (st.size() < (size_t)t.arity) throw std::runtime_error("Function args");
-
-            double result = 0;
-            if (t.arity == 1) {
-                double a = st.top(); st.pop();
-                if (t.text == "sin") result = std::sin(a);
-                else if (t.text == "cos") result = std::cos(a);
-                else if (t.text == "tan") result = std::tan(a);
-                else if (t.text == "arcsin" || t.text == "asin") result = std::asin(a);
-                else if (t.text == "arccos" || t.text == "acos") result = std::acos(a);
-                else if (t.text == "arctan" || t.text == "atan") result = std::atan(a);
-                else if (t.text == "sqrt") result = std::sqrt(a);
-                else if (t.text == "log" || t.text == "ln") result = std::log(a);
-                else if (t.text == "exp") result = std::exp(a);
-                else if (t.text == "neg") result = -a;
-                else if (t.text == "abs") result = std::fabs(a);
-                else result = std::nan("1");
-            }
-            else if (t.arity == 2) {
-                double b = st.top(); st.pop();
-                double a = st.top(); st.pop();
-                if (t.text == "pow") result = std::pow(a, b);
-                else result = std::nan("1");
-            }
-            st.push(result);
+template <class T>
+struct BindXY {
+    T x;
+    T y;
+    T loadX() const { return x; }
+    T loadY() const { return y; }
+    T loadVar(int) const { return T(0.0); }
+    T loadColumn(int) const { return T(0.0); }
+};
+
+// parameters come from a flat frame indexed by LoadVar slot, see bindVariables(); columns holds
+// this sample's value of each LoadColumn input
+template <class T>
+struct BindFrame {
+    T x;
+    T y;
+    const double* vars;
+    const T* columns = nullptr;
+    T loadX() const { return x; }
+    T loadY() const { return y; }
+    T loadVar(int slot) const { return T(vars[slot]); }
+    T loadColumn(int slot) const { return columns[slot]; }
+};
+
+// One interpreter for every numeric mode. T is any value type with the arithmetic operators and
+// sin/cos/.../pow/abs/powi overloads: double, float, Pack<VecOps>, Interval, Dual.
+template <class T, class Binding>
+inline T evaluate(const Program& p, const Binding& bind) {
+    using std::sin; using std::cos; using std::tan; using std::asin; using std::acos; using std::atan;
+    using std::sqrt; using std::log; using std::exp; using std::abs; using std::pow;
+    T st[PROGRAM_MAX_STACK];
+    T temps[PROGRAM_MAX_TEMPS];
+    T* sp = st;
+
+    for (const Instr& in : p.code) {
+        switch (in.op) {
+        case OpCode::Const:   *sp++ = T(in.value); break;
+        case OpCode::LoadX:   *sp++ = bind.loadX(); break;
+        case OpCode::LoadY:   *sp++ = bind.loadY(); break;
+        case OpCode::LoadVar: *sp++ = bind.loadVar(in.slot); break;
+        case OpCode::LoadColumn: *sp++ = bind.loadColumn(in.slot); break;
+        case OpCode::LoadTemp: *sp++ = temps[in.slot]; break;
+        case OpCode::Add: --sp; sp[-1] = sp[-1] + sp[0]; break;
+        case OpCode::Sub: --sp; sp[-1] = sp[-1] - sp[0]; break;
+        case OpCode::Mul: --sp; sp[-1] = sp[-1] * sp[0]; break;
+        case OpCode::Div: --sp; sp[-1] = sp[-1] / sp[0]; break;
+        case OpCode::Pow: --sp; sp[-1] = pow(sp[-1], sp[0]); break;
+        case OpCode::Neg:  sp[-1] = -sp[-1]; break;
+        case OpCode::Sin:  sp[-1] = sin(sp[-1]); break;
+        case OpCode::Cos:  sp[-1] = cos(sp[-1]); break;
+        case OpCode::Tan:  sp[-1] = tan(sp[-1]); break;
+        case OpCode::Asin: sp[-1] = asin(sp[-1]); break;
+        case OpCode::Acos: sp[-1] = acos(sp[-1]); break;
+        case OpCode::Atan: sp[-1] = atan(sp[-1]); break;
+        case OpCode::Sqrt: sp[-1] = sqrt(sp[-1]); break;
+        case OpCode::Log:  sp[-1] = log(sp[-1]); break;
+        case OpCode::Exp:  sp[-1] = exp(sp[-1]); break;
+        case OpCode::Abs:  sp[-1] = abs(sp[-1]); break;
+        case OpCode::PowI: sp[-1] = powi(sp[-1], in.slot); break;
+        case OpCode::StoreTemp: temps[in.slot] = sp[-1]; break;
         }
     }
+    return st[0];
+}
 
-    if (st.size() != 1) throw std::runtime_error("Invalid evaluation");
-    return st.top();
+inline double evaluateProgram(const Program& p, double xValue, double yValue, const double* vars) {
+    return evaluate<double>(p, BindFrame<double>{ xValue, yValue, vars });
 }
 
+// One-off evaluation of raw RPN. Each call compiles it first, so these throw std::runtime_error
+// from compileRPN on malformed input and pay a full compile per sample; loops should compile once
+// and call evaluateProgram or evaluateProgramBatch instead.
+inline double evaluateRPNVec(const std::vector<Token>& rpn, double xValue) {
+    return evaluate<double>(compileRPN(rpn), BindX<double>{ xValue });
+}
+
+inline double evaluateRPNXY(const std::vector<Token>& rpn, double xValue, double yValue) {
+    return evaluate<double>(compileRPN(rpn), BindXY<double>{ xValue, yValue });
+}
+
+// x and y are read from env like any other name
 inline double evaluateRPNEnv(const std::vector<Token>& rpn, const std::unordered_map<std::string,double>& env) {
-    std::stack<double> st;
-    for (const Token& t : rpn) {
-        if (t.type == TokenType::Number) st.push(t.number);
-        else if (t.type == TokenType::Variable) {
-            auto it = env.find(t.text);
-            if (it != env.end()) st.push(it->second);
-            else {
-                // fallback: x->0
-                if (t.text == "x") st.push(0.0);
-                else if (t.text == "y") st.push(0.0);
-                else st.push(0.0);
-            }
-        }
-        else if (t.type == TokenType::Operator) {
-            if (st.size() < 2) throw std::runtime_error("Invalid expression");
-            double b = st.top(); st.pop();
-            double a = st.top(); st.pop();
-            if (t.text == "+") st.push(a + b);
-            else if (t.text == "-") st.push(a - b);
-            else if (t.text == "*") st.push(a * b);
-            else if (t.text == "/") st.push(a / b);
-            else if (t.text == "^") st.push(std::pow(a, b));
+    Program p = compileRPN(rpn);
+    std::vector<double> vars = bindVariables(p, &env);
+    auto x = env.find("x"), y = env.find("y");
+    return evaluate<double>(p, BindFrame<double>{ x != env.end() ? x->second : 0.0, y != env.end() ? y->second : 0.0, vars.data() });
+}
+
+// number of lanes each instruction is applied to before moving on to the next one
+constexpr size_t BATCH_SIZE = 256;
+
+// Counts the NaN / inf entries of out[0, n) and, when invalid is non-null, flags them in it.
+// v - v is 0 for finite v and NaN otherwise, which keeps the loop branch-free.
+inline size_t markInvalid(const double* out, size_t n, uint8_t* invalid) {
+    size_t count = 0;
+    if (invalid) {
+        for (size_t i = 0; i < n; ++i) {
+            invalid[i] = (uint8_t)!(out[i] - out[i] == 0.0);
+            count += invalid[i];
         }
-        else if (t.type == TokenType::Function) {
-            if (st.size() < (size_t)t.arity) throw std::runtime_error("Function args");
-            double result = 0;
-            if (t.arity == 1) {
-                double a = st.top(); st.pop();
-                if (t.text == "sin") result = std::sin(a);
-                else if (t.text == "cos") result = std::cos(a);
-                else if (t.text == "tan") result = std::tan(a);
-                else if (t.text == "arcsin" || t.text == "asin") result = std::asin(a);
-                else if (t.text == "arccos" || t.text == "acos") result = std::acos(a);
-                else if (t.text == "arctan" || t.text == "atan") result = std::atan(a);
-                else if (t.text == "sqrt") result = std::sqrt(a);
-                else if (t.text == "log" || t.text == "ln") result = std::log(a);
-                else if (t.text == "exp") result = std::exp(a);
-                else if (t.text == "neg") result = -a;
-                else if (t.text == "abs") result = std::fabs(a);
-                else result = std::nan("1");
-            }
-            else if (t.arity == 2) {
-                double b = st.top(); st.pop();
-                double a = st.top(); st.pop();
-                if (t.text == "pow") result = std::pow(a, b);
-                else result = std::nan("1");
+    }
+    else {
+        for (size_t i = 0; i < n; ++i) count += (size_t)!(out[i] - out[i] == 0.0);
+    }
+    return count;
+}
+
+// Evaluates p for n samples at once: out[i] = f(xs[i], ys[i]). xs / ys may be null, in which
+// case the variable reads as 0; LoadColumn k reads columns[k][i]. Each instruction runs across a whole block of lanes, so the
+// dispatch cost is paid once per block and the arithmetic loops are simple enough to vectorize.
+// p has been validated by compileRPN, so nothing here can fail: domain errors propagate as NaN
+// and the return value is the number of non-finite results (flagged in invalid when non-null).
+inline size_t evaluateProgramBatch(const Program& p, const double* xs, const double* ys, const double* vars, double* out, size_t n, uint8_t* invalid = nullptr,
+    const double* const* columns = nullptr) {
+    std::vector<double> stack((size_t)std::max(p.maxStack, 1) * BATCH_SIZE);
+    std::vector<double> temps((size_t)p.tempCount * BATCH_SIZE);
+    size_t count = 0;
+
+    for (size_t base = 0; base < n; base += BATCH_SIZE) {
+        const size_t m = std::min(BATCH_SIZE, n - base);
+        double* top = stack.data();
+        size_t depth = 0;
+
+        for (const Instr& in : p.code) {
+            if (in.op <= OpCode::LoadTemp) top = stack.data() + BATCH_SIZE * depth++;
+            else if (in.op <= OpCode::Pow) top = stack.data() + BATCH_SIZE * (--depth - 1);
+            const double* b = top + BATCH_SIZE;
+
+            switch (in.op) {
+            case OpCode::Const: std::fill(top, top + m, in.value); break;
+            case OpCode::LoadX:
+                if (xs) std::copy(xs + base, xs + base + m, top);
+                else std::fill(top, top + m, 0.0);
+                break;
+            case OpCode::LoadY:
+                if (ys) std::copy(ys + base, ys + base + m, top);
+                else std::fill(top, top + m, 0.0);
+                break;
+            case OpCode::LoadVar: std::fill(top, top + m, vars[in.slot]); break;
+            case OpCode::LoadColumn: std::copy(columns[in.slot] + base, columns[in.slot] + base + m, top); break;
+            case OpCode::LoadTemp: std::copy(temps.data() + BATCH_SIZE * in.slot, temps.data() + BATCH_SIZE * in.slot + m, top); break;
+            case OpCode::Add:  for (size_t i = 0; i < m; ++i) top[i] = top[i] + b[i]; break;
+            case OpCode::Sub:  for (size_t i = 0; i < m; ++i) top[i] = top[i] - b[i]; break;
+            case OpCode::Mul:  for (size_t i = 0; i < m; ++i) top[i] = top[i] * b[i]; break;
+            case OpCode::Div:  for (size_t i = 0; i < m; ++i) top[i] = top[i] / b[i]; break;
+            case OpCode::Pow:  vecPow(top, b, top, m); break;
+            case OpCode::Neg:  for (size_t i = 0; i < m; ++i) top[i] = -top[i]; break;
+            case OpCode::Sin:  vecSin(top, top, m); break;
+            case OpCode::Cos:  vecCos(top, top, m); break;
+            case OpCode::Tan:  vecTan(top, top, m); break;
+            case OpCode::Asin: vecAsin(top, top, m); break;
+            case OpCode::Acos: vecAcos(top, top, m); break;
+            case OpCode::Atan: vecAtan(top, top, m); break;
+            case OpCode::Sqrt: vecSqrt(top, top, m); break;
+            case OpCode::Log:  vecLog(top, top, m); break;
+            case OpCode::Exp:  vecExp(top, top, m); break;
+            case OpCode::Abs:  vecAbs(top, top, m); break;
+            case OpCode::PowI: for (size_t i = 0; i < m; ++i) top[i] = powi(top[i], in.slot); break;
+            case OpCode::StoreTemp: std::copy(top, top + m, temps.data() + BATCH_SIZE * in.slot); break;
             }
-            st.push(result);
         }
+        std::copy(stack.data(), stack.data() + m, out + base);
+        count += markInvalid(out + base, m, invalid ? invalid + base : nullptr);
     }
-    if (st.size() != 1) throw std::runtime_error("Invalid evaluation");
-    return st.top();
+    return count;
 }
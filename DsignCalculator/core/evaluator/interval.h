@@ -0,0 +1,156 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Closed interval [lo, hi] enclosing every value a subexpression can take over a box of inputs.
+// Results are widened by one ulp per operation so libm and rounding error stay inside the bounds.
+// An empty result (sqrt of a negative interval, asin outside [-1, 1]) has NaN bounds.
+struct Interval {
+    double lo = 0.0;
+    double hi = 0.0;
+
+    Interval() = default;
+    Interval(double v) : lo(v), hi(v) {}
+    Interval(double l, double h) : lo(l), hi(h) {}
+
+    bool empty() const { return !(lo <= hi); }
+    bool contains(double v) const { return lo <= v && v <= hi; }
+    double width() const { return hi - lo; }
+
+    static Interval whole() { return { -std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity() }; }
+    static Interval none() { return { std::nan("1"), std::nan("1") }; }
+};
+
+namespace interval_detail {
+
+inline Interval widen(double lo, double hi) {
+    if (!(lo <= hi)) return Interval::none();
+    return { std::nextafter(lo, -std::numeric_limits<double>::infinity()), std::nextafter(hi, std::numeric_limits<double>::infinity()) };
+}
+
+// 0 * inf counts as 0 so an unbounded factor does not poison a product with a zero bound
+inline double mulBound(double a, double b) {
+    double r = a * b;
+    return r != r ? 0.0 : r;
+}
+
+constexpr double PI = 3.14159265358979323846;
+
+// true when [lo, hi] contains offset + 2k*pi for some integer k
+inline bool containsPeriodic(double lo, double hi, double offset) {
+    double k = std::ceil((lo - offset) / (2.0 * PI));
+    return offset + 2.0 * PI * k <= hi;
+}
+
+} // namespace interval_detail
+
+inline Interval operator+(Interval a, Interval b) { return interval_detail::widen(a.lo + b.lo, a.hi + b.hi); }
+inline Interval operator-(Interval a, Interval b) { return interval_detail::widen(a.lo - b.hi, a.hi - b.lo); }
+inline Interval operator-(Interval a) { return { -a.hi, -a.lo }; }
+
+inline Interval operator*(Interval a, Interval b) {
+    using interval_detail::mulBound;
+    if (a.empty() || b.empty()) return Interval::none();
+    double p[4] = { mulBound(a.lo, b.lo), mulBound(a.lo, b.hi), mulBound(a.hi, b.lo), mulBound(a.hi, b.hi) };
+    return interval_detail::widen(*std::min_element(p, p + 4), *std::max_element(p, p + 4));
+}
+
+inline Interval operator/(Interval a, Interval b) {
+    if (a.empty() || b.empty()) return Interval::none();
+    if (b.contains(0.0)) return Interval::whole();
+    return a * interval_detail::widen(1.0 / b.hi, 1.0 / b.lo);
+}
+
+inline Interval abs(Interval a) {
+    if (a.lo >= 0.0) return a;
+    if (a.hi <= 0.0) return -a;
+    return { 0.0, std::max(-a.lo, a.hi) };
+}
+
+inline Interval sqrt(Interval a) {
+    if (a.empty() || a.hi < 0.0) return Interval::none();
+    return interval_detail::widen(std::sqrt(std::max(a.lo, 0.0)), std::sqrt(a.hi));
+}
+
+inline Interval exp(Interval a) {
+    if (a.empty()) return a;
+    return interval_detail::widen(std::max(std::exp(a.lo), 0.0), std::exp(a.hi));
+}
+
+inline Interval log(Interval a) {
+    if (a.empty() || a.hi < 0.0) return Interval::none();
+    double lo = a.lo > 0.0 ? std::log(a.lo) : -std::numeric_limits<double>::infinity();
+    return interval_detail::widen(lo, std::log(a.hi));
+}
+
+inline Interval atan(Interval a) {
+    if (a.empty()) return a;
+    return interval_detail::widen(std::atan(a.lo), std::atan(a.hi));
+}
+
+inline Interval asin(Interval a) {
+    if (a.empty() || a.hi < -1.0 || a.lo > 1.0) return Interval::none();
+    return interval_detail::widen(std::asin(std::max(a.lo, -1.0)), std::asin(std::min(a.hi, 1.0)));
+}
+
+inline Interval acos(Interval a) {
+    if (a.empty() || a.hi < -1.0 || a.lo > 1.0) return Interval::none();
+    return interval_detail::widen(std::acos(std::min(a.hi, 1.0)), std::acos(std::max(a.lo, -1.0)));
+}
+
+inline Interval sin(Interval a) {
+    using namespace interval_detail;
+    if (a.empty() || !std::isfinite(a.lo) || !std::isfinite(a.hi) || a.width() >= 2.0 * PI) return { -1.0, 1.0 };
+    double s0 = std::sin(a.lo), s1 = std::sin(a.hi);
+    double lo = containsPeriodic(a.lo, a.hi, -0.5 * PI) ? -1.0 : std::min(s0, s1);
+    double hi = containsPeriodic(a.lo, a.hi, 0.5 * PI) ? 1.0 : std::max(s0, s1);
+    Interval r = widen(lo, hi);
+    return { std::max(r.lo, -1.0), std::min(r.hi, 1.0) };
+}
+
+inline Interval cos(Interval a) {
+    using namespace interval_detail;
+    if (a.empty() || !std::isfinite(a.lo) || !std::isfinite(a.hi) || a.width() >= 2.0 * PI) return { -1.0, 1.0 };
+    double c0 = std::cos(a.lo), c1 = std::cos(a.hi);
+    double lo = containsPeriodic(a.lo, a.hi, PI) ? -1.0 : std::min(c0, c1);
+    double hi = containsPeriodic(a.lo, a.hi, 0.0) ? 1.0 : std::max(c0, c1);
+    Interval r = widen(lo, hi);
+    return { std::max(r.lo, -1.0), std::min(r.hi, 1.0) };
+}
+
+inline Interval tan(Interval a) {
+    using namespace interval_detail;
+    if (a.empty()) return a;
+    if (!std::isfinite(a.lo) || !std::isfinite(a.hi) || a.width() >= PI) return Interval::whole();
+    // poles at pi/2 + k*pi
+    if (containsPeriodic(a.lo, a.hi, 0.5 * PI) || containsPeriodic(a.lo, a.hi, -0.5 * PI)) return Interval::whole();
+    return widen(std::tan(a.lo), std::tan(a.hi));
+}
+
+inline Interval powi(Interval a, int n) {
+    if (a.empty()) return a;
+    if (n == 0) return Interval(1.0);
+    if (n < 0) return Interval(1.0) / powi(a, -n);
+    double l = std::pow(a.lo, n), h = std::pow(a.hi, n);
+    if (n % 2 == 1) return interval_detail::widen(l, h);
+    if (a.lo >= 0.0) return interval_detail::widen(l, h);
+    if (a.hi <= 0.0) return interval_detail::widen(h, l);
+    return interval_detail::widen(0.0, std::max(l, h));
+}
+
+// real pow: integral exponents also accept negative bases, otherwise only the base's non-negative part counts
+inline Interval pow(Interval a, Interval b) {
+    if (a.empty() || b.empty()) return Interval::none();
+    if (b.lo == b.hi && b.lo == std::floor(b.lo) && std::fabs(b.lo) <= 1024.0) return powi(a, (int)b.lo);
+    if (a.hi < 0.0) return Interval::none();
+    Interval base(std::max(a.lo, 0.0), a.hi);
+    if (base.lo == 0.0) {
+        // 0^b is 0 for b > 0, 1 for b == 0 and inf for b < 0
+        double c[4] = { std::pow(base.lo, b.lo), std::pow(base.lo, b.hi), std::pow(base.hi, b.lo), std::pow(base.hi, b.hi) };
+        double lo = *std::min_element(c, c + 4), hi = *std::max_element(c, c + 4);
+        if (b.contains(0.0)) { lo = std::min(lo, 1.0); hi = std::max(hi, 1.0); }
+        return interval_detail::widen(lo, hi);
+    }
+    return exp(b * log(base));
+}
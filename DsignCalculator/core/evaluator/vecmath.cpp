@@ -0,0 +1,60 @@
+#include "vecmath.h"
+
+#ifdef VECMATH_SSE2
+using namespace vecmath_detail;
+
+#define VECMATH_UNARY(name, kernel, ref) \
+    void name(const double* in, double* out, size_t n) { \
+        applyUnary<VecOps>(in, out, n, [](Pack<VecOps> x, Pack<VecOps>& ok) { return kernel<VecOps>(x, ok); }, \
+            [](double a) { return ref(a); }); \
+    }
+
+VECMATH_UNARY(vecSin, sinKernel, std::sin)
+VECMATH_UNARY(vecCos, cosKernel, std::cos)
+VECMATH_UNARY(vecTan, tanKernel, std::tan)
+VECMATH_UNARY(vecAsin, asinKernel, std::asin)
+VECMATH_UNARY(vecAcos, acosKernel, std::acos)
+VECMATH_UNARY(vecAtan, atanKernel, std::atan)
+VECMATH_UNARY(vecLog, logKernel, std::log)
+VECMATH_UNARY(vecExp, expKernel, std::exp)
+
+void vecSqrt(const double* in, double* out, size_t n) {
+    size_t i = 0;
+    for (; i + VecOps::lanes <= n; i += VecOps::lanes) sqrt(Pack<VecOps>::load(in + i)).store(out + i);
+    for (; i < n; ++i) out[i] = std::sqrt(in[i]);
+}
+
+void vecAbs(const double* in, double* out, size_t n) {
+    size_t i = 0;
+    for (; i + VecOps::lanes <= n; i += VecOps::lanes) abs(Pack<VecOps>::load(in + i)).store(out + i);
+    for (; i < n; ++i) out[i] = std::fabs(in[i]);
+}
+
+void vecPow(const double* a, const double* b, double* out, size_t n) {
+    applyBinary<VecOps>(a, b, out, n, [](Pack<VecOps> x, Pack<VecOps> y, Pack<VecOps>& ok) { return powKernel<VecOps>(x, y, ok); },
+        [](double x, double y) { return std::pow(x, y); });
+}
+
+#else
+
+#define VECMATH_UNARY(name, ref) \
+    void name(const double* in, double* out, size_t n) { \
+        for (size_t i = 0; i < n; ++i) out[i] = ref(in[i]); \
+    }
+
+VECMATH_UNARY(vecSin, std::sin)
+VECMATH_UNARY(vecCos, std::cos)
+VECMATH_UNARY(vecTan, std::tan)
+VECMATH_UNARY(vecAsin, std::asin)
+VECMATH_UNARY(vecAcos, std::acos)
+VECMATH_UNARY(vecAtan, std::atan)
+VECMATH_UNARY(vecLog, std::log)
+VECMATH_UNARY(vecExp, std::exp)
+VECMATH_UNARY(vecSqrt, std::sqrt)
+VECMATH_UNARY(vecAbs, std::fabs)
+
+void vecPow(const double* a, const double* b, double* out, size_t n) {
+    for (size_t i = 0; i < n; ++i) out[i] = std::pow(a[i], b[i]);
+}
+
+#endif
@@ -0,0 +1,442 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <cfloat>
+
+// Vectorized versions of the function_table built-ins, used by the batch evaluator.
+// evaluateProgram keeps calling libm and stays the reference implementation.
+//
+// Each kernel covers a "fast domain" with polynomial / range-reduction code. Lanes outside it
+// (NaN, infinities, huge trig arguments, non-positive log inputs, ...) are recomputed with libm,
+// so the special-case behaviour is exactly the scalar one. Error bounds inside the fast domain,
+// measured against libm over the whole domain:
+//   sin, cos      |x| <= 1e6                            <= 2 ULP
+//   tan           |x| <= 1e6                            <= 4 ULP
+//   exp           |x| <= 708                            <= 1 ULP
+//   log           normal positive x                     <= 1 ULP
+//   atan          all x                                 <= 1 ULP
+//   asin, acos    |x| <= 1                              <= 2 ULP
+//   pow(a, b)     a normal positive, |b*ln a| <= 708    <= 2 * (1 + |b*ln a|) ULP
+//   sqrt, abs     all x                                 exact
+// pow is the weak one: its log's rounding error is scaled by b before exp, so it can be off by
+// about 1400 ULP as |b*ln a| nears 708. DsignTests/vecmath_tests.cpp reproduces the table.
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define VECMATH_SSE2 1
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#define VECMATH_AVX2 1
+#include <immintrin.h>
+#endif
+
+#ifdef VECMATH_SSE2
+struct Sse2Ops {
+    using V = __m128d;
+    using I = __m128i;
+    static constexpr int lanes = 2;
+    static constexpr int fullMask = 0x3;
+
+    static V set1(double a) { return _mm_set1_pd(a); }
+    static V load(const double* p) { return _mm_loadu_pd(p); }
+    static void store(double* p, V a) { _mm_storeu_pd(p, a); }
+    static V add(V a, V b) { return _mm_add_pd(a, b); }
+    static V sub(V a, V b) { return _mm_sub_pd(a, b); }
+    static V mul(V a, V b) { return _mm_mul_pd(a, b); }
+    static V div(V a, V b) { return _mm_div_pd(a, b); }
+    static V sqrt(V a) { return _mm_sqrt_pd(a); }
+    static V band(V a, V b) { return _mm_and_pd(a, b); }
+    static V bor(V a, V b) { return _mm_or_pd(a, b); }
+    static V bxor(V a, V b) { return _mm_xor_pd(a, b); }
+    static V bandnot(V a, V b) { return _mm_andnot_pd(a, b); }
+    static V lt(V a, V b) { return _mm_cmplt_pd(a, b); }
+    static V le(V a, V b) { return _mm_cmple_pd(a, b); }
+    static V gt(V a, V b) { return _mm_cmpgt_pd(a, b); }
+    static V ge(V a, V b) { return _mm_cmpge_pd(a, b); }
+    static V select(V m, V a, V b) { return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b)); }
+    static int mask(V m) { return _mm_movemask_pd(m); }
+
+    static I asInt(V a) { return _mm_castpd_si128(a); }
+    static V asDouble(I a) { return _mm_castsi128_pd(a); }
+    static I set1i(int64_t a) { return _mm_set1_epi64x(a); }
+    static I addi(I a, I b) { return _mm_add_epi64(a, b); }
+    static I subi(I a, I b) { return _mm_sub_epi64(a, b); }
+    static I andi(I a, I b) { return _mm_and_si128(a, b); }
+    static I ori(I a, I b) { return _mm_or_si128(a, b); }
+    template <int N> static I shli(I a) { return _mm_slli_epi64(a, N); }
+    template <int N> static I shri(I a) { return _mm_srli_epi64(a, N); }
+};
+#endif
+
+#ifdef VECMATH_AVX2
+struct Avx2Ops {
+    using V = __m256d;
+    using I = __m256i;
+    static constexpr int lanes = 4;
+    static constexpr int fullMask = 0xF;
+
+    static V set1(double a) { return _mm256_set1_pd(a); }
+    static V load(const double* p) { return _mm256_loadu_pd(p); }
+    static void store(double* p, V a) { _mm256_storeu_pd(p, a); }
+    static V add(V a, V b) { return _mm256_add_pd(a, b); }
+    static V sub(V a, V b) { return _mm256_sub_pd(a, b); }
+    static V mul(V a, V b) { return _mm256_mul_pd(a, b); }
+    static V div(V a, V b) { return _mm256_div_pd(a, b); }
+    static V sqrt(V a) { return _mm256_sqrt_pd(a); }
+    static V band(V a, V b) { return _mm256_and_pd(a, b); }
+    static V bor(V a, V b) { return _mm256_or_pd(a, b); }
+    static V bxor(V a, V b) { return _mm256_xor_pd(a, b); }
+    static V bandnot(V a, V b) { return _mm256_andnot_pd(a, b); }
+    static V lt(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+    static V le(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+    static V gt(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+    static V ge(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+    static V select(V m, V a, V b) { return _mm256_blendv_pd(b, a, m); }
+    static int mask(V m) { return _mm256_movemask_pd(m); }
+
+    static I asInt(V a) { return _mm256_castpd_si256(a); }
+    static V asDouble(I a) { return _mm256_castsi256_pd(a); }
+    static I set1i(int64_t a) { return _mm256_set1_epi64x(a); }
+    static I addi(I a, I b) { return _mm256_add_epi64(a, b); }
+    static I subi(I a, I b) { return _mm256_sub_epi64(a, b); }
+    static I andi(I a, I b) { return _mm256_and_si256(a, b); }
+    static I ori(I a, I b) { return _mm256_or_si256(a, b); }
+    template <int N> static I shli(I a) { return _mm256_slli_epi64(a, N); }
+    template <int N> static I shri(I a) { return _mm256_srli_epi64(a, N); }
+};
+#endif
+
+// Arithmetic wrapper so the kernels below read like the scalar code they mirror.
+// Comparisons return all-ones / all-zeros lane masks.
+template <class O>
+struct Pack {
+    using V = typename O::V;
+    using I = typename O::I;
+    static constexpr int lanes = O::lanes;
+    V v;
+
+    Pack() = default;
+    Pack(V a) : v(a) {}
+    Pack(double a) : v(O::set1(a)) {}
+
+    static Pack load(const double* p) { return Pack(O::load(p)); }
+    void store(double* p) const { O::store(p, v); }
+    I bits() const { return O::asInt(v); }
+    static Pack fromBits(I a) { return Pack(O::asDouble(a)); }
+
+    friend Pack operator+(Pack a, Pack b) { return O::add(a.v, b.v); }
+    friend Pack operator-(Pack a, Pack b) { return O::sub(a.v, b.v); }
+    friend Pack operator*(Pack a, Pack b) { return O::mul(a.v, b.v); }
+    friend Pack operator/(Pack a, Pack b) { return O::div(a.v, b.v); }
+    friend Pack operator-(Pack a) { return O::bxor(a.v, O::set1(-0.0)); }
+    friend Pack operator&(Pack a, Pack b) { return O::band(a.v, b.v); }
+    friend Pack operator|(Pack a, Pack b) { return O::bor(a.v, b.v); }
+    friend Pack operator^(Pack a, Pack b) { return O::bxor(a.v, b.v); }
+    friend Pack operator~(Pack a) { return O::bxor(a.v, O::asDouble(O::set1i(-1))); }
+    friend Pack operator<(Pack a, Pack b) { return O::lt(a.v, b.v); }
+    friend Pack operator<=(Pack a, Pack b) { return O::le(a.v, b.v); }
+    friend Pack operator>(Pack a, Pack b) { return O::gt(a.v, b.v); }
+    friend Pack operator>=(Pack a, Pack b) { return O::ge(a.v, b.v); }
+    friend Pack select(Pack m, Pack a, Pack b) { return O::select(m.v, a.v, b.v); }
+    friend Pack abs(Pack a) { return O::bandnot(O::set1(-0.0), a.v); }
+    friend Pack sqrt(Pack a) { return O::sqrt(a.v); }
+    friend int laneMask(Pack m) { return O::mask(m.v); }
+};
+
+namespace vecmath_detail {
+
+constexpr double ROUND_MAGIC = 6755399441055744.0; // 1.5 * 2^52
+constexpr double TWO52 = 4503599627370496.0;
+
+// round-to-nearest of |x| < 2^51, also returning the integer in the low bits of each lane
+template <class O>
+inline Pack<O> roundToInt(Pack<O> x, typename O::I& k) {
+    Pack<O> t = x + ROUND_MAGIC;
+    k = O::subi(t.bits(), Pack<O>(ROUND_MAGIC).bits());
+    return t - ROUND_MAGIC;
+}
+
+// 2^k for integer lanes k in [-1022, 1023]
+template <class O>
+inline Pack<O> pow2i(typename O::I k) {
+    return Pack<O>::fromBits(O::template shli<52>(O::addi(k, O::set1i(1023))));
+}
+
+template <class O>
+inline Pack<O> expKernel(Pack<O> x, Pack<O>& ok) {
+    const double LN2HI = 6.93147180369123816490e-01, LN2LO = 1.90821492927058770002e-10;
+    const double P1 = 1.66666666666666019037e-01, P2 = -2.77777777770155933842e-03,
+        P3 = 6.61375632143793436117e-05, P4 = -1.65339022054652515390e-06, P5 = 4.13813679705723846039e-08;
+    ok = abs(x) <= 708.0;
+    typename O::I k;
+    Pack<O> kd = roundToInt<O>(x * 1.44269504088896338700e+00, k);
+    Pack<O> hi = x - kd * LN2HI;
+    Pack<O> lo = kd * LN2LO;
+    Pack<O> r = hi - lo;
+    Pack<O> t = r * r;
+    Pack<O> c = r - t * (P1 + t * (P2 + t * (P3 + t * (P4 + t * P5))));
+    Pack<O> y = Pack<O>(1.0) - ((lo - (r * c) / (Pack<O>(2.0) - c)) - hi);
+    return y * pow2i<O>(k);
+}
+
+template <class O>
+inline Pack<O> logKernel(Pack<O> x, Pack<O>& ok) {
+    const double LN2HI = 6.93147180369123816490e-01, LN2LO = 1.90821492927058770002e-10;
+    const double Lg1 = 6.666666666666735130e-01, Lg2 = 3.999999999940941908e-01, Lg3 = 2.857142874366239149e-01,
+        Lg4 = 2.222219843214978396e-01, Lg5 = 1.818357216161805012e-01, Lg6 = 1.531383769920937332e-01,
+        Lg7 = 1.479819860511658591e-01;
+    ok = (x >= DBL_MIN) & (x <= DBL_MAX);
+    typename O::I bits = x.bits();
+    // biased exponent -> double via the 2^52 trick, mantissa rescaled into [1, 2)
+    Pack<O> e = Pack<O>::fromBits(O::ori(O::template shri<52>(bits), Pack<O>(TWO52).bits())) - (TWO52 + 1023.0);
+    Pack<O> m = Pack<O>::fromBits(O::ori(O::andi(bits, O::set1i(0x000FFFFFFFFFFFFFLL)), Pack<O>(1.0).bits()));
+    Pack<O> big = m > 1.41421356237309504880;
+    m = select(big, m * 0.5, m);
+    e = e + (big & 1.0);
+
+    Pack<O> f = m - 1.0;
+    Pack<O> hfsq = 0.5 * f * f;
+    Pack<O> s = f / (Pack<O>(2.0) + f);
+    Pack<O> z = s * s;
+    Pack<O> w = z * z;
+    Pack<O> t1 = w * (Lg2 + w * (Lg4 + w * Lg6));
+    Pack<O> t2 = z * (Lg1 + w * (Lg3 + w * (Lg5 + w * Lg7)));
+    Pack<O> R = t2 + t1;
+    return e * LN2HI - ((hfsq - (s * (hfsq + R) + e * LN2LO)) - f);
+}
+
+// x = k*pi/2 + r, |r| <= pi/4; returns sin(r), cos(r) and k
+template <class O>
+inline void sinCosKernel(Pack<O> x, Pack<O>& sr, Pack<O>& cr, typename O::I& k) {
+    const double PIO2_1 = 1.57079632673412561417e+00, PIO2_2 = 6.07710050630396597660e-11,
+        PIO2_3 = 2.02226624871116645580e-21;
+    const double S1 = -1.66666666666666324348e-01, S2 = 8.33333333332248946124e-03, S3 = -1.98412698298579493134e-04,
+        S4 = 2.75573137070700676789e-06, S5 = -2.50507602534068634195e-08, S6 = 1.58969099521155010221e-10;
+    const double C1 = 4.16666666666666019037e-02, C2 = -1.38888888888741095749e-03, C3 = 2.48015872894767294178e-05,
+        C4 = -2.75573143513906633035e-07, C5 = 2.08757232129817482790e-09, C6 = -1.13596475577881948265e-11;
+
+    Pack<O> kd = roundToInt<O>(x * 6.36619772367581382433e-01, k);
+    Pack<O> r = ((x - kd * PIO2_1) - kd * PIO2_2) - kd * PIO2_3;
+    Pack<O> z = r * r;
+
+    sr = r + z * r * (S1 + z * (S2 + z * (S3 + z * (S4 + z * (S5 + z * S6)))));
+
+    Pack<O> hz = 0.5 * z;
+    Pack<O> w = Pack<O>(1.0) - hz;
+    Pack<O> cpoly = z * (C1 + z * (C2 + z * (C3 + z * (C4 + z * (C5 + z * C6)))));
+    cr = w + (((Pack<O>(1.0) - w) - hz) + z * cpoly);
+}
+
+// all-ones lanes where bit 0 of k is set
+template <class O>
+inline Pack<O> oddMask(typename O::I k) {
+    return Pack<O>::fromBits(O::subi(O::set1i(0), O::andi(k, O::set1i(1))));
+}
+
+// sign bit taken from bit 1 of k
+template <class O>
+inline Pack<O> quadrantSign(typename O::I k) {
+    return Pack<O>::fromBits(O::template shli<62>(O::andi(k, O::set1i(2))));
+}
+
+constexpr double TRIG_LIMIT = 1.0e6;
+
+template <class O>
+inline Pack<O> sinKernel(Pack<O> x, Pack<O>& ok) {
+    ok = abs(x) <= TRIG_LIMIT;
+    Pack<O> s, c; typename O::I k;
+    sinCosKernel<O>(x, s, c, k);
+    return select(oddMask<O>(k), c, s) ^ quadrantSign<O>(k);
+}
+
+template <class O>
+inline Pack<O> cosKernel(Pack<O> x, Pack<O>& ok) {
+    ok = abs(x) <= TRIG_LIMIT;
+    Pack<O> s, c; typename O::I k;
+    sinCosKernel<O>(x, s, c, k);
+    return select(oddMask<O>(k), s, c) ^ quadrantSign<O>(O::addi(k, O::set1i(1)));
+}
+
+template <class O>
+inline Pack<O> tanKernel(Pack<O> x, Pack<O>& ok) {
+    ok = abs(x) <= TRIG_LIMIT;
+    Pack<O> s, c; typename O::I k;
+    sinCosKernel<O>(x, s, c, k);
+    Pack<O> odd = oddMask<O>(k);
+    return select(odd, -c, s) / select(odd, s, c);
+}
+
+// Cephes atan: reduce to |x| <= 0.66 around 0, pi/4 or pi/2 and apply a rational approximation
+template <class O>
+inline Pack<O> atanKernel(Pack<O> x, Pack<O>& ok) {
+    const double P0 = -8.750608600031904122785e-01, P1 = -1.615753718733365076637e+01, P2 = -7.500855792314704667340e+01,
+        P3 = -1.228866684490136173410e+02, P4 = -6.485021904942025371773e+01;
+    const double Q0 = 2.485846490142306297962e+01, Q1 = 1.650270098316988542046e+02, Q2 = 4.328810604912902668951e+02,
+        Q3 = 4.853903996359136964868e+02, Q4 = 1.945506571482613964425e+02;
+    const double MOREBITS = 6.123233995736765886130e-17;
+    ok = Pack<O>::fromBits(O::set1i(-1));
+
+    Pack<O> sign = x & -0.0;
+    Pack<O> ax = abs(x);
+    Pack<O> big = ax > 2.41421356237309504880;
+    Pack<O> mid = (ax > 0.66) & ~big;
+    Pack<O> base = select(big, Pack<O>(1.57079632679489661923), select(mid, Pack<O>(0.78539816339744830962), Pack<O>(0.0)));
+    Pack<O> extra = select(big, Pack<O>(MOREBITS), select(mid, Pack<O>(0.5 * MOREBITS), Pack<O>(0.0)));
+    Pack<O> xr = select(big, Pack<O>(-1.0) / ax, select(mid, (ax - 1.0) / (ax + 1.0), ax));
+
+    Pack<O> z = xr * xr;
+    Pack<O> p = (((P0 * z + P1) * z + P2) * z + P3) * z + P4;
+    Pack<O> q = ((((z + Q0) * z + Q1) * z + Q2) * z + Q3) * z + Q4;
+    Pack<O> r = xr * (z * p / q) + xr;
+    return (base + (r + extra)) ^ sign;
+}
+
+template <class O>
+inline Pack<O> asinKernel(Pack<O> x, Pack<O>& ok) {
+    Pack<O> unused;
+    ok = abs(x) <= 1.0;
+    return atanKernel<O>(x / sqrt((Pack<O>(1.0) - x) * (Pack<O>(1.0) + x)), unused);
+}
+
+template <class O>
+inline Pack<O> acosKernel(Pack<O> x, Pack<O>& ok) {
+    Pack<O> unused;
+    ok = abs(x) <= 1.0;
+    return 2.0 * atanKernel<O>(sqrt((Pack<O>(1.0) - x) / (Pack<O>(1.0) + x)), unused);
+}
+
+template <class O>
+inline Pack<O> powKernel(Pack<O> a, Pack<O> b, Pack<O>& ok) {
+    Pack<O> okLog, okExp;
+    Pack<O> t = b * logKernel<O>(a, okLog);
+    Pack<O> r = expKernel<O>(t, okExp);
+    ok = okLog & okExp;
+    return r;
+}
+
+// Runs kernel over in[0..n), patching lanes outside its fast domain with the libm reference.
+// in and out may alias.
+template <class O, class Kernel, class Ref>
+inline void applyUnary(const double* in, double* out, size_t n, Kernel kernel, Ref ref) {
+    auto block = [&](const double* src, double* dst) {
+        Pack<O> x = Pack<O>::load(src), ok;
+        Pack<O> r = kernel(x, ok);
+        int m = laneMask(ok);
+        if (m == O::fullMask) { r.store(dst); return; }
+        double xv[O::lanes];
+        x.store(xv);
+        r.store(dst);
+        for (int j = 0; j < O::lanes; ++j) if (!((m >> j) & 1)) dst[j] = ref(xv[j]);
+    };
+    size_t i = 0;
+    for (; i + O::lanes <= n; i += O::lanes) block(in + i, out + i);
+    if (i < n) {
+        double tmp[O::lanes] = {};
+        for (size_t j = i; j < n; ++j) tmp[j - i] = in[j];
+        block(tmp, tmp);
+        for (size_t j = i; j < n; ++j) out[j] = tmp[j - i];
+    }
+}
+
+template <class O, class Kernel, class Ref>
+inline void applyBinary(const double* a, const double* b, double* out, size_t n, Kernel kernel, Ref ref) {
+    auto block = [&](const double* sa, const double* sb, double* dst) {
+        Pack<O> x = Pack<O>::load(sa), y = Pack<O>::load(sb), ok;
+        Pack<O> r = kernel(x, y, ok);
+        int m = laneMask(ok);
+        if (m == O::fullMask) { r.store(dst); return; }
+        double xv[O::lanes], yv[O::lanes];
+        x.store(xv); y.store(yv);
+        r.store(dst);
+        for (int j = 0; j < O::lanes; ++j) if (!((m >> j) & 1)) dst[j] = ref(xv[j], yv[j]);
+    };
+    size_t i = 0;
+    for (; i + O::lanes <= n; i += O::lanes) block(a + i, b + i, out + i);
+    if (i < n) {
+        double ta[O::lanes] = {}, tb[O::lanes] = {};
+        for (size_t j = i; j < n; ++j) { ta[j - i] = a[j]; tb[j - i] = b[j]; }
+        block(ta, tb, ta);
+        for (size_t j = i; j < n; ++j) out[j] = ta[j - i];
+    }
+}
+
+} // namespace vecmath_detail
+
+#if defined(VECMATH_AVX2)
+using VecOps = Avx2Ops;
+#elif defined(VECMATH_SSE2)
+using VecOps = Sse2Ops;
+#endif
+
+#ifdef VECMATH_SSE2
+constexpr int VECMATH_LANES = VecOps::lanes;
+#else
+constexpr int VECMATH_LANES = 1;
+#endif
+
+#ifdef VECMATH_SSE2
+namespace vecmath_detail {
+
+// kernel result with the lanes outside its fast domain recomputed by ref
+template <class O, class Kernel, class Ref>
+inline Pack<O> patchLanes(Pack<O> x, Kernel kernel, Ref ref) {
+    Pack<O> ok;
+    Pack<O> r = kernel(x, ok);
+    int m = laneMask(ok);
+    if (m == O::fullMask) return r;
+    double xv[O::lanes], rv[O::lanes];
+    x.store(xv);
+    r.store(rv);
+    for (int j = 0; j < O::lanes; ++j) if (!((m >> j) & 1)) rv[j] = ref(xv[j]);
+    return Pack<O>::load(rv);
+}
+
+} // namespace vecmath_detail
+
+// whole-pack math so Pack can be used as a value type by the templated evaluator
+#define VECMATH_PACK_UNARY(name, kernel) \
+    template <class O> \
+    inline Pack<O> name(Pack<O> x) { \
+        return vecmath_detail::patchLanes(x, [](Pack<O> v, Pack<O>& ok) { return vecmath_detail::kernel<O>(v, ok); }, \
+            [](double a) { return std::name(a); }); \
+    }
+
+VECMATH_PACK_UNARY(sin, sinKernel)
+VECMATH_PACK_UNARY(cos, cosKernel)
+VECMATH_PACK_UNARY(tan, tanKernel)
+VECMATH_PACK_UNARY(asin, asinKernel)
+VECMATH_PACK_UNARY(acos, acosKernel)
+VECMATH_PACK_UNARY(atan, atanKernel)
+VECMATH_PACK_UNARY(log, logKernel)
+VECMATH_PACK_UNARY(exp, expKernel)
+#undef VECMATH_PACK_UNARY
+
+template <class O>
+inline Pack<O> pow(Pack<O> a, Pack<O> b) {
+    Pack<O> ok;
+    Pack<O> r = vecmath_detail::powKernel<O>(a, b, ok);
+    int m = laneMask(ok);
+    if (m == O::fullMask) return r;
+    double av[O::lanes], bv[O::lanes], rv[O::lanes];
+    a.store(av);
+    b.store(bv);
+    r.store(rv);
+    for (int j = 0; j < O::lanes; ++j) if (!((m >> j) & 1)) rv[j] = std::pow(av[j], bv[j]);
+    return Pack<O>::load(rv);
+}
+#endif
+
+// out[i] = f(in[i]); in and out may alias
+void vecSin(const double* in, double* out, size_t n);
+void vecCos(const double* in, double* out, size_t n);
+void vecTan(const double* in, double* out, size_t n);
+void vecAsin(const double* in, double* out, size_t n);
+void vecAcos(const double* in, double* out, size_t n);
+void vecAtan(const double* in, double* out, size_t n);
+void vecSqrt(const double* in, double* out, size_t n);
+void vecLog(const double* in, double* out, size_t n);
+void vecExp(const double* in, double* out, size_t n);
+void vecAbs(const double* in, double* out, size_t n);
+// out[i] = pow(a[i], b[i]); out may alias a or b
+void vecPow(const double* a, const double* b, double* out, size_t n);
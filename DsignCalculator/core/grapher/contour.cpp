@@ -0,0 +1,419 @@
+#include "contour.h"
+#include "../evaluator/evaluator.h"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+constexpr size_t QUADTREE_TASK_CELLS = 1024;
+constexpr int QUADTREE_MAX_LEVEL = 24;
+
+// position of iso on the edge from a to b; an edge with a non-finite end crosses at a
+static double edgeCrossing(double va, double vb, double iso) {
+    return std::isfinite(va) && std::isfinite(vb) && vb != va ? (iso - va) / (vb - va) : 0.0;
+}
+
+enum CellEdge { TOP, RIGHT, BOTTOM, LEFT };
+
+// The segments the contour has in a cell whose corners are inside where mask has
+// TL | TR << 1 | BR << 2 | BL << 3 set, as the pairs of edges ends[0, 1] and, for the saddles 5
+// and 10, ends[2, 3]; returns how many there are. A saddle's segments cut off the two corners the
+// cell centre, taken as the average of the corner values v (TL, TR, BR, BL), does not connect.
+static int cellSegments(int mask, const double (&v)[4], double iso, int ends[4]) {
+    auto set = [&](int a, int b) { ends[0] = a; ends[1] = b; return 1; };
+    switch (mask) {
+    case 1: case 14: return set(TOP, LEFT);
+    case 2: case 13: return set(TOP, RIGHT);
+    case 3: case 12: return set(RIGHT, LEFT);
+    case 4: case 11: return set(BOTTOM, RIGHT);
+    case 6: case 9: return set(TOP, BOTTOM);
+    case 7: case 8: return set(LEFT, BOTTOM);
+    case 5: case 10: {
+        bool centreInside = 0.25 * (v[0] + v[1] + v[2] + v[3]) >= iso;
+        if ((mask == 5) == centreInside) { set(TOP, RIGHT); ends[2] = BOTTOM; ends[3] = LEFT; }
+        else { set(TOP, LEFT); ends[2] = RIGHT; ends[3] = BOTTOM; }
+        return 2;
+    }
+    default: return 0;
+    }
+}
+
+void marchingSquares(const double* values, int nx, int ny, ptrdiff_t rowPitch, ptrdiff_t colPitch,
+    double x0, double y0, double dx, double dy, int rowBegin, int rowEnd,
+    std::vector<sf::Vector2f>& edges, std::vector<uint32_t>& edgeIds, double iso)
+{
+    rowEnd = std::min(rowEnd, ny - 1);
+    if (nx < 2 || rowBegin >= rowEnd) return;
+
+    auto value = [&](int i, int j) { return values[j * rowPitch + i * colPitch]; };
+    auto crossing = [&](double va, double vb) { return edgeCrossing(va, vb, iso); };
+    std::vector<uint8_t> insideTop(nx), insideBottom(nx);
+    std::vector<sf::Vector2f> top(nx - 1), bottom(nx - 1), side(nx);
+    // horizontal crossings of row j, where its nodes fall on opposite sides of iso
+    auto rowCrossings = [&](int j, std::vector<uint8_t>& inside, std::vector<sf::Vector2f>& cross) {
+        for (int i = 0; i < nx; ++i) inside[i] = value(i, j) >= iso;
+        float y = static_cast<float>(y0 + j * dy);
+        for (int i = 0; i + 1 < nx; ++i) {
+            if (inside[i] == inside[i + 1]) continue;
+            double t = crossing(value(i, j), value(i + 1, j));
+            cross[i] = sf::Vector2f(static_cast<float>(x0 + (i + t) * dx), y);
+        }
+    };
+
+    rowCrossings(rowBegin, insideTop, top);
+    for (int j = rowBegin; j < rowEnd; ++j) {
+        rowCrossings(j + 1, insideBottom, bottom);
+        for (int i = 0; i < nx; ++i) {
+            if (insideTop[i] == insideBottom[i]) continue;
+            double t = crossing(value(i, j), value(i, j + 1));
+            side[i] = sf::Vector2f(static_cast<float>(x0 + i * dx), static_cast<float>(y0 + (j + t) * dy));
+        }
+        for (int i = 0; i + 1 < nx; ++i) {
+            int mask = insideTop[i] | insideTop[i + 1] << 1 | insideBottom[i + 1] << 2 | insideBottom[i] << 3;
+            if (mask == 0 || mask == 15) continue;
+            const double v[4] = { value(i, j), value(i + 1, j), value(i + 1, j + 1), value(i, j + 1) };
+            int ends[4];
+            int count = cellSegments(mask, v, iso, ends);
+            const sf::Vector2f* point[4] = { &top[i], &side[i + 1], &bottom[i], &side[i] };
+            const uint32_t id[4] = { gridEdgeId(nx, i, j, false), gridEdgeId(nx, i + 1, j, true),
+                gridEdgeId(nx, i, j + 1, false), gridEdgeId(nx, i, j, true) };
+            for (int k = 0; k < 2 * count; ++k) {
+                edges.push_back(*point[ends[k]]);
+                edgeIds.push_back(id[ends[k]]);
+            }
+        }
+        insideTop.swap(insideBottom);
+        top.swap(bottom);
+    }
+}
+std::vector<std::vector<sf::Vector2f>> stitchSegments(const std::vector<sf::Vector2f>& edges,
+    const std::vector<uint32_t>& edgeIds, size_t edgeCount)
+{
+    // the other endpoint on the same grid edge, or -1 for the end of a chain
+    std::vector<int32_t> partner(edges.size(), -1);
+    std::vector<int32_t> seen(edgeCount, -1);
+    for (size_t k = 0; k < edgeIds.size(); ++k) {
+        int32_t& other = seen[edgeIds[k]];
+        if (other < 0) { other = (int32_t)k; continue; }
+        partner[k] = other;
+        partner[other] = (int32_t)k;
+    }
+
+    std::vector<uint8_t> used(edges.size() / 2, 0);
+    std::vector<std::vector<sf::Vector2f>> lines;
+    // enters the segment of endpoint k there and follows the chain until it ends or comes back around
+    auto follow = [&](size_t k) {
+        std::vector<sf::Vector2f> line{ edges[k] };
+        for (;;) {
+            used[k / 2] = 1;
+            size_t out = k ^ 1;
+            line.push_back(edges[out]);
+            int32_t next = partner[out];
+            if (next < 0 || used[next / 2]) break;
+            k = (size_t)next;
+        }
+        lines.push_back(std::move(line));
+    };
+    for (size_t k = 0; k < edges.size(); ++k) {
+        if (partner[k] < 0 && !used[k / 2]) follow(k);
+    }
+    for (size_t s = 0; s < used.size(); ++s) {
+        if (!used[s]) follow(2 * s);
+    }
+    return lines;
+}
+
+ImplicitQuadtree::ImplicitQuadtree(const Program& body, std::vector<double> vars, double xMin, double xMax, double yMin, double yMax,
+    double pixelsPerUnit)
+    : body_(body), vars_(std::move(vars)), x0_(xMin), y0_(yMin), width_(xMax - xMin), height_(yMax - yMin), pixelsPerUnit_(pixelsPerUnit)
+{
+    if (jitPreferred(body_)) jit_ = compileJit(body_);
+    if (width_ > 0.0 && height_ > 0.0) cells_.push_back({ 0, 0 });
+}
+
+bool ImplicitQuadtree::refine(double leafPx, ThreadPool* pool, const StopToken* stop, size_t cellBudget) {
+    while (std::max(width_, height_) * pixelsPerUnit_ > leafPx * std::ldexp(1.0, level_)
+        && level_ < QUADTREE_MAX_LEVEL && cells_.size() * 4 <= cellBudget) {
+        if (stop && stop->stopRequested()) return false;
+        const double cw = std::ldexp(width_, -level_), ch = std::ldexp(height_, -level_);
+        std::vector<uint8_t> keep(cells_.size());
+        {
+            TaskGroup group(pool);
+            for (size_t begin = 0; begin < cells_.size(); begin += QUADTREE_TASK_CELLS) {
+                group.run([&, begin]() {
+                    size_t end = std::min(cells_.size(), begin + QUADTREE_TASK_CELLS);
+                    for (size_t c = begin; c < end; ++c) {
+                        const Cell& cell = cells_[c];
+                        Interval x(x0_ + cell.i * cw, x0_ + (cell.i + 1) * cw);
+                        Interval y(y0_ + cell.j * ch, y0_ + (cell.j + 1) * ch);
+                        keep[c] = evaluate<Interval>(body_, BindFrame<Interval>{ x, y, vars_.data() }).contains(0.0);
+                    }
+                });
+            }
+            group.wait();
+        }
+        intervalEvaluations_ += cells_.size();
+
+        // children row by row, so the cells stay in row-major order
+        std::vector<Cell> next;
+        for (size_t begin = 0, end; begin < cells_.size(); begin = end) {
+            for (end = begin; end < cells_.size() && cells_[end].j == cells_[begin].j; ++end) {}
+            for (uint32_t half = 0; half < 2; ++half) {
+                for (size_t c = begin; c < end; ++c) {
+                    if (!keep[c]) continue;
+                    next.push_back({ cells_[c].i * 2, cells_[c].j * 2 + half });
+                    next.push_back({ cells_[c].i * 2 + 1, cells_[c].j * 2 + half });
+                }
+            }
+        }
+        cells_.swap(next);
+        ++level_;
+    }
+    return true;
+}
+
+std::vector<std::vector<sf::Vector2f>> ImplicitQuadtree::contour(ThreadPool* pool) {
+    // The nodes at the cell corners, row after row in increasing column order. A row of nodes is
+    // shared by the rows of cells above and below it, so its columns are the union of theirs.
+    auto cornerColumns = [&](size_t begin, size_t end, std::vector<uint32_t>& out) {
+        out.clear();
+        for (size_t c = begin; c < end; ++c) {
+            if (out.empty() || out.back() != cells_[c].i) out.push_back(cells_[c].i);
+            out.push_back(cells_[c].i + 1);
+        }
+    };
+    std::vector<double> xs, ys;
+    std::vector<uint32_t> nodeColumns;
+    std::vector<std::pair<size_t, size_t>> cellRowNodes;  // first node of the rows above and below each row of cells
+    std::vector<uint32_t> above, below, merged;
+    const double dx = std::ldexp(width_, -level_), dy = std::ldexp(height_, -level_);
+    auto addNodeRow = [&](uint32_t j, const std::vector<uint32_t>& columns) {
+        for (uint32_t i : columns) {
+            xs.push_back(x0_ + i * dx);
+            ys.push_back(y0_ + j * dy);
+            nodeColumns.push_back(i);
+        }
+    };
+    // below holds the columns of the row under the previous row of cells, until it is added
+    bool belowPending = false;
+    uint32_t belowRow = 0;
+    for (size_t begin = 0, end; begin < cells_.size(); begin = end) {
+        const uint32_t j = cells_[begin].j;
+        for (end = begin; end < cells_.size() && cells_[end].j == j; ++end) {}
+        cornerColumns(begin, end, above);
+        size_t top = xs.size();
+        if (belowPending && belowRow == j) {
+            merged.clear();
+            std::set_union(below.begin(), below.end(), above.begin(), above.end(), std::back_inserter(merged));
+            addNodeRow(j, merged);
+        }
+        else {
+            if (belowPending) addNodeRow(belowRow, below);
+            top = xs.size();
+            addNodeRow(j, above);
+        }
+        // the row below comes next, whether on its own or merged with the next row of cells
+        cellRowNodes.push_back({ top, xs.size() });
+        below.swap(above);
+        belowRow = j + 1;
+        belowPending = true;
+    }
+    if (belowPending) addNodeRow(belowRow, below);
+
+    // the corners cells share are evaluated once
+    const size_t n = xs.size();
+    std::vector<double> values(n);
+    {
+        TaskGroup group(pool);
+        for (size_t begin = 0; begin < n; begin += QUADTREE_TASK_CELLS * 4) {
+            group.run([&, begin]() {
+                size_t m = std::min(n - begin, QUADTREE_TASK_CELLS * 4);
+                if (jit_.isNative()) jit_.evaluateBatch(xs.data() + begin, ys.data() + begin, vars_.data(), values.data() + begin, m);
+                else evaluateProgramBatch(body_, xs.data() + begin, ys.data() + begin, vars_.data(), values.data() + begin, m);
+            });
+        }
+        group.wait();
+    }
+    pointEvaluations_ += n;
+
+    // One marching squares cell per quadtree cell. Node k starts the horizontal grid edge 2k and
+    // the vertical one 2k + 1, like gridEdgeId; the node after k in its row is its right neighbour.
+    std::vector<sf::Vector2f> edges;
+    std::vector<uint32_t> edgeIds;
+    size_t row = 0;
+    for (size_t begin = 0, end; begin < cells_.size(); begin = end, ++row) {
+        const uint32_t j = cells_[begin].j;
+        for (end = begin; end < cells_.size() && cells_[end].j == j; ++end) {}
+        size_t tl = cellRowNodes[row].first, bl = cellRowNodes[row].second;
+        for (size_t c = begin; c < end; ++c) {
+            const uint32_t i = cells_[c].i;
+            while (nodeColumns[tl] != i) ++tl;
+            while (nodeColumns[bl] != i) ++bl;
+            const double v[4] = { values[tl], values[tl + 1], values[bl + 1], values[bl] };
+            int mask = (v[0] >= 0.0) | (v[1] >= 0.0) << 1 | (v[2] >= 0.0) << 2 | (v[3] >= 0.0) << 3;
+            int ends[4];
+            int count = cellSegments(mask, v, 0.0, ends);
+            for (int k = 0; k < 2 * count; ++k) {
+                double t;
+                switch (ends[k]) {
+                case TOP:
+                    t = edgeCrossing(v[0], v[1], 0.0);
+                    edges.emplace_back(static_cast<float>(x0_ + (i + t) * dx), static_cast<float>(y0_ + j * dy));
+                    edgeIds.push_back((uint32_t)tl * 2);
+                    break;
+                case RIGHT:
+                    t = edgeCrossing(v[1], v[2], 0.0);
+                    edges.emplace_back(static_cast<float>(x0_ + (i + 1) * dx), static_cast<float>(y0_ + (j + t) * dy));
+                    edgeIds.push_back((uint32_t)(tl + 1) * 2 + 1);
+                    break;
+                case BOTTOM:
+                    t = edgeCrossing(v[3], v[2], 0.0);
+                    edges.emplace_back(static_cast<float>(x0_ + (i + t) * dx), static_cast<float>(y0_ + (j + 1) * dy));
+                    edgeIds.push_back((uint32_t)bl * 2);
+                    break;
+                default:
+                    t = edgeCrossing(v[0], v[3], 0.0);
+                    edges.emplace_back(static_cast<float>(x0_ + i * dx), static_cast<float>(y0_ + (j + t) * dy));
+                    edgeIds.push_back((uint32_t)tl * 2 + 1);
+                    break;
+                }
+            }
+        }
+    }
+    return stitchSegments(edges, edgeIds, n * 2);
+}
+
+ContourTracer::ContourTracer(const Program& body, std::vector<double> vars, int64_t ix0, int64_t iy0, double dx, double dy, int nx, int ny)
+    : body_(body), vars_(std::move(vars)), ix0_(ix0), iy0_(iy0), dx_(dx), dy_(dy), nx_(nx), ny_(ny),
+      values_((size_t)nx * ny), known_((size_t)nx * ny, 0), traced_((size_t)nx * ny * 2, 0)
+{
+    if (jitPreferred(body_)) jit_ = compileJit(body_);
+}
+
+double ContourTracer::value(int i, int j) {
+    size_t k = (size_t)j * nx_ + i;
+    if (!known_[k]) {
+        double x = (double)(ix0_ + i) * dx_, y = (double)(iy0_ + j) * dy_;
+        values_[k] = jit_.isNative() ? jit_.evaluate(x, y, vars_.data()) : evaluateProgram(body_, x, y, vars_.data());
+        known_[k] = 1;
+        ++evaluations_;
+    }
+    return values_[k];
+}
+
+sf::Vector2f ContourTracer::crossing(uint32_t edge) {
+    int i = (int)(edge / 2 % nx_), j = (int)(edge / 2 / nx_);
+    double x0 = (double)ix0_ * dx_, y0 = (double)iy0_ * dy_;
+    if (edge & 1) {
+        double t = edgeCrossing(value(i, j), value(i, j + 1), 0.0);
+        return { static_cast<float>(x0 + i * dx_), static_cast<float>(y0 + (j + t) * dy_) };
+    }
+    double t = edgeCrossing(value(i, j), value(i + 1, j), 0.0);
+    return { static_cast<float>(x0 + (i + t) * dx_), static_cast<float>(y0 + j * dy_) };
+}
+
+int ContourTracer::exitEdge(int i, int j, int entry) {
+    const double v[4] = { value(i, j), value(i + 1, j), value(i + 1, j + 1), value(i, j + 1) };
+    int mask = (v[0] >= 0.0) | (v[1] >= 0.0) << 1 | (v[2] >= 0.0) << 2 | (v[3] >= 0.0) << 3;
+    int ends[4];
+    int count = cellSegments(mask, v, 0.0, ends);
+    for (int k = 0; k < 2 * count; ++k) {
+        if (ends[k] == entry) return ends[k ^ 1];
+    }
+    return -1;
+}
+
+std::vector<sf::Vector2f> ContourTracer::follow(uint32_t seed, int i, int j, int entry, bool& closed) {
+    std::vector<sf::Vector2f> line{ crossing(seed) };
+    closed = false;
+    while (i >= 0 && j >= 0 && i + 1 < nx_ && j + 1 < ny_) {
+        int exit = exitEdge(i, j, entry);
+        if (exit < 0) break;
+        const uint32_t edges[4] = { gridEdgeId(nx_, i, j, false), gridEdgeId(nx_, i + 1, j, true),
+            gridEdgeId(nx_, i, j + 1, false), gridEdgeId(nx_, i, j, true) };
+        uint32_t edge = edges[exit];
+        line.push_back(crossing(edge));
+        if (edge == seed) {
+            closed = true;
+            break;
+        }
+        if (traced_[edge]) break;
+        traced_[edge] = 1;
+        switch (exit) {
+        case TOP: --j; entry = BOTTOM; break;
+        case RIGHT: ++i; entry = LEFT; break;
+        case BOTTOM: ++j; entry = TOP; break;
+        default: --i; entry = RIGHT; break;
+        }
+    }
+    return line;
+}
+
+std::vector<std::vector<sf::Vector2f>> ContourTracer::trace(int seedStride, const StopToken* stop) {
+    const int s = std::max(1, seedStride);
+    std::fill(traced_.begin(), traced_.end(), 0);
+    std::vector<int> columns, rows;
+    for (int i = 0; i < nx_; i += s) columns.push_back(i);
+    if (columns.back() != nx_ - 1) columns.push_back(nx_ - 1);
+    for (int j = 0; j < ny_; j += s) rows.push_back(j);
+    if (rows.back() != ny_ - 1) rows.push_back(ny_ - 1);
+
+    // the scanned nodes in one batch
+    std::vector<double> xs, ys, out;
+    std::vector<size_t> index;
+    for (int j : rows) {
+        for (int i : columns) {
+            size_t k = (size_t)j * nx_ + i;
+            if (known_[k]) continue;
+            xs.push_back((double)(ix0_ + i) * dx_);
+            ys.push_back((double)(iy0_ + j) * dy_);
+            index.push_back(k);
+        }
+    }
+    out.resize(xs.size());
+    if (jit_.isNative()) jit_.evaluateBatch(xs.data(), ys.data(), vars_.data(), out.data(), xs.size());
+    else evaluateProgramBatch(body_, xs.data(), ys.data(), vars_.data(), out.data(), xs.size());
+    for (size_t m = 0; m < index.size(); ++m) {
+        values_[index[m]] = out[m];
+        known_[index[m]] = 1;
+    }
+    evaluations_ += xs.size();
+
+    std::vector<std::vector<sf::Vector2f>> lines;
+    auto inside = [&](int i, int j) { return value(i, j) >= 0.0; };
+    // traces the curve through a crossed edge both ways from it, unless it has been traced already
+    auto start = [&](int i, int j, bool vertical) {
+        uint32_t seed = gridEdgeId(nx_, i, j, vertical);
+        if (traced_[seed]) return;
+        traced_[seed] = 1;
+        bool closed;
+        auto line = vertical ? follow(seed, i, j, LEFT, closed) : follow(seed, i, j, TOP, closed);
+        if (!closed) {
+            auto back = vertical ? follow(seed, i - 1, j, RIGHT, closed) : follow(seed, i, j - 1, BOTTOM, closed);
+            std::reverse(back.begin(), back.end());
+            back.pop_back();
+            back.insert(back.end(), line.begin(), line.end());
+            line.swap(back);
+        }
+        if (line.size() >= 2) lines.push_back(std::move(line));
+    };
+    // a scanned edge whose ends differ is crossed on at least one of the lattice edges along it
+    for (int j : rows) {
+        for (size_t c = 0; c + 1 < columns.size(); ++c) {
+            if (stop && stop->stopRequested()) return lines;
+            if (inside(columns[c], j) == inside(columns[c + 1], j)) continue;
+            for (int i = columns[c]; i < columns[c + 1]; ++i) {
+                if (inside(i, j) != inside(i + 1, j)) start(i, j, false);
+            }
+        }
+    }
+    for (int i : columns) {
+        for (size_t r = 0; r + 1 < rows.size(); ++r) {
+            if (stop && stop->stopRequested()) return lines;
+            if (inside(i, rows[r]) == inside(i, rows[r + 1])) continue;
+            for (int j = rows[r]; j < rows[r + 1]; ++j) {
+                if (inside(i, j) != inside(i, j + 1)) start(i, j, true);
+            }
+        }
+    }
+    return lines;
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include "../compiler/compiler.h"
+#include "../jit/jit.h"
+#include "../threading/stop_token.h"
+#include "../threading/thread_pool.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// How relations that are not solved for x or y get plotted.
+enum class ImplicitMethod {
+    Grid,      // marching squares over a fixed grid of up to 300 x 300 nodes
+    Quadtree,  // ImplicitQuadtree
+    Trace,     // ContourTracer on the grid's nodes
+};
+
+// the grid edge from node (i, j) to (i + 1, j), or to (i, j + 1) when vertical
+inline uint32_t gridEdgeId(int nx, int i, int j, bool vertical) {
+    return (uint32_t)(j * nx + i) * 2 + (vertical ? 1 : 0);
+}
+
+// Contour of an nx x ny grid of values at iso, for the cell rows [rowBegin, rowEnd): node (i, j) lies
+// at (x0 + i * dx, y0 + j * dy) and reads values[j * rowPitch + i * colPitch]. Each crossing cell adds
+// its segment to edges as a pair of endpoints, and to edgeIds the grid edges they lie on (see
+// gridEdgeId). One row pair is processed at a time, and every edge crossing is interpolated once,
+// for both cells that share the edge.
+void marchingSquares(const double* values, int nx, int ny, ptrdiff_t rowPitch, ptrdiff_t colPitch,
+    double x0, double y0, double dx, double dy, int rowBegin, int rowEnd,
+    std::vector<sf::Vector2f>& edges, std::vector<uint32_t>& edgeIds, double iso = 0.0);
+
+// Joins contour segments into polylines through the grid edges they share: edges holds the segments
+// as pairs of endpoints, edgeIds the grid edge (below edgeCount) of each endpoint. An edge is shared
+// by at most two cells, so the segments form open chains and closed loops; a loop ends on its first
+// point again.
+std::vector<std::vector<sf::Vector2f>> stitchSegments(const std::vector<sf::Vector2f>& edges,
+    const std::vector<uint32_t>& edgeIds, size_t edgeCount);
+
+constexpr double QUADTREE_LEAF_PX = 1.0;
+constexpr size_t QUADTREE_CELL_BUDGET = 1u << 18;
+
+// Zero set of f(x, y) over a box by recursive subdivision. Each level evaluates f over every cell
+// in interval arithmetic, drops the cells whose bounds exclude 0 (or where f is nowhere defined)
+// and splits the rest in four, so only cells the curve may pass through get smaller. The cells of
+// the last level are contoured from the values at their corners, like marching squares cells.
+class ImplicitQuadtree {
+public:
+    // body reads x, y and the parameters in vars, no LoadColumn inputs
+    ImplicitQuadtree(const Program& body, std::vector<double> vars, double xMin, double xMax, double yMin, double yMax,
+        double pixelsPerUnit);
+
+    // Subdivides until the cells are at most leafPx wide and high, or until the next level would
+    // hold more than cellBudget cells. stop is polled once per level; false when it interrupted
+    // the subdivision, which a later call resumes.
+    bool refine(double leafPx, ThreadPool* pool, const StopToken* stop = nullptr,
+        size_t cellBudget = QUADTREE_CELL_BUDGET);
+    // polylines through the current cells, in world coordinates
+    std::vector<std::vector<sf::Vector2f>> contour(ThreadPool* pool);
+
+    size_t cellCount() const { return cells_.size(); }
+    size_t intervalEvaluations() const { return intervalEvaluations_; }
+    size_t pointEvaluations() const { return pointEvaluations_; }
+
+private:
+    // cell (i, j) of level L covers [i, i + 1] x [j, j + 1] in units of the box size / 2^L
+    struct Cell {
+        uint32_t i;
+        uint32_t j;
+    };
+
+    Program body_;
+    std::vector<double> vars_;
+    JitProgram jit_;
+    double x0_, y0_, width_, height_, pixelsPerUnit_;
+    int level_ = 0;
+    std::vector<Cell> cells_;
+    size_t intervalEvaluations_ = 0;
+    size_t pointEvaluations_ = 0;
+};
+
+// Follows the zero set of f(x, y) through the cells of an nx x ny lattice whose node (i, j) lies at
+// ((ix0 + i) * dx, (iy0 + j) * dy), like the grid's. Sign changes between the nodes of every
+// seedStride-th row and column seed the curves, and each is traced cell by cell until it closes
+// or leaves the lattice, so apart from that scan only the nodes of cells a curve passes through
+// are evaluated. Loops small enough to slip between the scanned nodes are missed.
+class ContourTracer {
+public:
+    // body reads x, y and the parameters in vars, no LoadColumn inputs
+    ContourTracer(const Program& body, std::vector<double> vars, int64_t ix0, int64_t iy0, double dx, double dy, int nx, int ny);
+
+    // polylines in world coordinates; stop is polled between curves, and the ones traced before it
+    // are returned. Calling again starts over, with the nodes evaluated so far kept.
+    std::vector<std::vector<sf::Vector2f>> trace(int seedStride, const StopToken* stop = nullptr);
+
+    size_t evaluations() const { return evaluations_; }
+
+private:
+    double value(int i, int j);
+    sf::Vector2f crossing(uint32_t edge);
+    // the edge the curve leaves cell (i, j) through, after entering it through `entry`, or -1
+    int exitEdge(int i, int j, int entry);
+    std::vector<sf::Vector2f> follow(uint32_t seed, int i, int j, int entry, bool& closed);
+
+    Program body_;
+    std::vector<double> vars_;
+    JitProgram jit_;
+    int64_t ix0_, iy0_;
+    double dx_, dy_;
+    int nx_, ny_;
+    std::vector<double> values_;      // row-major, valid where known_ is set
+    std::vector<uint8_t> known_;
+    std::vector<uint8_t> traced_;     // by gridEdgeId
+    size_t evaluations_ = 0;
+};
@@ -0,0 +1,126 @@
+#include "graph_service.h"
+#include "grapher.h"
+#include "../threading/stop_token.h"
+#include "../threading/thread_pool.h"
+
+GraphService::GraphService(ThreadPool* pool) : pool_(pool) {
+    thread_ = std::thread([this]() { run(); });
+}
+
+GraphService::~GraphService() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        if (running_) running_->store(true);
+    }
+    wake_.notify_all();
+    thread_.join();
+}
+
+uint64_t GraphService::post(GraphJob job) {
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_ = std::move(job);
+        generation = ++generation_;
+        if (running_) running_->store(true);
+    }
+    wake_.notify_one();
+    return generation;
+}
+
+std::shared_ptr<const GraphFrame> GraphService::latest() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return published_;
+}
+
+void GraphService::run() {
+    for (;;) {
+        GraphJob job;
+        uint64_t generation;
+        std::atomic<bool> cancel(false);
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&]() { return stopping_ || pending_.has_value(); });
+            if (stopping_) return;
+            job = std::move(*pending_);
+            pending_.reset();
+            generation = generation_;
+            running_ = &cancel;
+        }
+
+        const GraphView& v = job.view;
+        double xMin = (0.0 - v.centerX) / v.scale;
+        double xMax = ((double)v.screenWidth - v.centerX) / v.scale;
+        StopToken stop{ &cancel };
+        std::vector<std::unique_ptr<ProgressiveGraph>> graphs(job.rpn.size());
+        std::vector<uint8_t> fellBack(job.rpn.size(), 0);
+
+        // publish a frame after every level, coarse previews first
+        bool failed = false;
+        for (int level = 0; !failed && !cancel.load(); ++level) {
+            bool pending = false;
+            {
+                TaskGroup group(pool_);
+                for (size_t i = 0; i < job.rpn.size(); ++i) {
+                    if (job.rpn[i].empty() || (graphs[i] && graphs[i]->done())) continue;
+                    pending = true;
+                    group.run([&, i]() {
+                        if (!graphs[i]) {
+                            graphs[i] = std::make_unique<ProgressiveGraph>(job.rpn[i], job.colors[i], v.scale, xMin, xMax,
+                                v.centerX, v.centerY, v.screenWidth, v.screenHeight, &job.env, pool_, &tiles_, job.implicit);
+                            if (i < finished_.size() && finished_[i]) graphs[i]->reuse(*finished_[i]);
+                        }
+                        graphs[i]->refine(stop);
+                        // a new expression that plots nothing gives way to the one it replaced, whose
+                        // preview goes into this level's frame so the old curve never leaves the screen
+                        if (graphs[i]->done() && graphs[i]->segments().empty() && !fellBack[i] &&
+                            i < job.fallback.size() && !job.fallback[i].empty()) {
+                            fellBack[i] = 1;
+                            graphs[i] = std::make_unique<ProgressiveGraph>(job.fallback[i], job.colors[i], v.scale, xMin, xMax,
+                                v.centerX, v.centerY, v.screenWidth, v.screenHeight, &job.env, pool_, &tiles_, job.implicit);
+                            if (i < finished_.size() && finished_[i]) graphs[i]->reuse(*finished_[i]);
+                            graphs[i]->refine(stop);
+                        }
+                    });
+                }
+                try { group.wait(); }
+                catch (...) { failed = true; }
+            }
+            if (!pending || failed || cancel.load()) break;
+
+            auto frame = std::make_shared<GraphFrame>();
+            frame->generation = generation;
+            frame->level = level;
+            frame->view = v;
+            frame->graphs.resize(job.rpn.size());
+            frame->fellBack = fellBack;
+            frame->complete = true;
+            for (size_t i = 0; i < graphs.size(); ++i) {
+                if (!graphs[i]) continue;
+                frame->graphs[i] = graphs[i]->segments();
+                frame->complete = frame->complete && graphs[i]->done();
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!cancel.load()) published_ = std::move(frame);
+        }
+
+        // finished graphs seed the next job, whether or not this one was cut short
+        finished_.resize(graphs.size());
+        for (size_t i = 0; i < graphs.size(); ++i) {
+            if (graphs[i] && graphs[i]->done()) finished_[i] = std::move(graphs[i]);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = nullptr;
+    }
+}
+
+sf::Transform viewCorrection(const GraphView& computed, const GraphView& current) {
+    float k = (float)(current.scale / computed.scale);
+    sf::Transform t;
+    t.translate((float)current.centerX, (float)current.centerY);
+    t.scale(k, k);
+    t.translate((float)-computed.centerX, (float)-computed.centerY);
+    return t;
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include "../tokenizer/tokenizer.h"
+#include "contour.h"
+#include "tile_cache.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class ProgressiveGraph;
+class ThreadPool;
+
+// The screen mapping graphs are computed for: screen = center + world * scale, y pointing down.
+struct GraphView {
+    double scale = 50.0;
+    double centerX = 0.0;
+    double centerY = 0.0;
+    int screenWidth = 0;
+    int screenHeight = 0;
+};
+
+// Everything a computation needs, copied so the UI can go on editing its own state.
+struct GraphJob {
+    GraphView view;
+    std::vector<std::vector<Token>> rpn;  // empty entries produce empty graphs
+    std::vector<sf::Color> colors;        // one per entry of rpn
+    // per entry of rpn, may be shorter: drawn instead when the entry's finished graph is empty,
+    // which keeps the previous expression on screen when a new one plots nothing
+    std::vector<std::vector<Token>> fallback;
+    std::unordered_map<std::string, double> env;
+    ImplicitMethod implicit = ImplicitMethod::Grid;
+};
+
+struct GraphFrame {
+    uint64_t generation = 0;
+    int level = 0;          // 0 for the coarse preview, counting up as the graphs are refined
+    bool complete = false;  // every graph is at full resolution
+    GraphView view;
+    std::vector<std::vector<std::vector<sf::Vertex>>> graphs;
+    std::vector<uint8_t> fellBack;  // per graph: set when it is drawn from GraphJob::fallback
+};
+
+// Computes graph jobs on a background thread. post() replaces a job still waiting and cancels the
+// one in progress, so only the latest view gets finished. A frame is published after every
+// refinement level, coarse preview first; frames are never modified once published, so the UI can
+// keep drawing the one it holds while the next is being built.
+class GraphService {
+public:
+    explicit GraphService(ThreadPool* pool);
+    ~GraphService();
+    GraphService(const GraphService&) = delete;
+    GraphService& operator=(const GraphService&) = delete;
+
+    // returns the generation the job's frame will carry
+    uint64_t post(GraphJob job);
+    // the newest published frame, or null before the first one
+    std::shared_ptr<const GraphFrame> latest() const;
+    // explicit curve tiles shared by all jobs, kept across views
+    const TileCache& tiles() const { return tiles_; }
+
+private:
+    void run();
+
+    ThreadPool* pool_;
+    TileCache tiles_;
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::optional<GraphJob> pending_;
+    uint64_t generation_ = 0;
+    std::atomic<bool>* running_ = nullptr;  // cancel flag of the job being computed
+    std::shared_ptr<const GraphFrame> published_;
+    std::vector<std::unique_ptr<ProgressiveGraph>> finished_;  // the last finished graph of each entry, for reuse()
+    bool stopping_ = false;
+    std::thread thread_;
+};
+
+// Maps vertices computed for `computed` onto the screen of `current`, so a frame can be drawn
+// panned and zoomed until its replacement arrives.
+sf::Transform viewCorrection(const GraphView& computed, const GraphView& current);
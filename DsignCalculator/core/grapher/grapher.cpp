@@ -1,6 +1,15 @@
 #include "grapher.h"
 #include "../parser/core_parser.h"
 #include "../evaluator/evaluator.h"
+#include "../compiler/compiler.h"
+#include "../jit/jit.h"
+#include "../optimizer/optimizer.h"
+#include "../optimizer/hoisting.h"
+#include "../optimizer/equation.h"
+#include "sampler.h"
+#include "contour.h"
+#include "../threading/stop_token.h"
+#include "../threading/thread_pool.h"
 #include "../tokenizer/tokenizer.h"
 #include <iostream>
 #include <cmath>
@@ -8,6 +17,9 @@
 #include <atomic>
 #include <algorithm>
 
+constexpr int GRID_BAND_ROWS = 16;
+constexpr int COARSE_STRIDE = 4;
+
 static bool rpnUsesY(const std::vector<Token>& rpn) {
     for (auto& t : rpn) if (t.type == TokenType::Variable && t.text == "y") return true;
     return false;
@@ -22,203 +34,353 @@ std::vector<sf::Vector2f> computeWorldSamplesFromRPN(const std::vector<Token>& r
     if (step > 0) estimated = (size_t)((xMax - xMin) / step) + 1;
     samples.reserve(std::min<size_t>(std::max<size_t>(estimated, 16), 200000));
 
-    for (double x = xMin; x <= xMax; x += step) {
-        try {
-            double y;
-            if (env) {
-                std::unordered_map<std::string, double> local = *env;
-                local["x"] = x;
-                y = evaluateRPNEnv(rpn, local);
-            }
-            else {
-                y = evaluateRPNVec(rpn, x);
-            }
-            if (!std::isfinite(y)) continue;
-            samples.emplace_back(static_cast<float>(x), static_cast<float>(y));
-        }
-        catch (...) { /* ignore individual eval errors */ }
+    Program program;
+    try { program = optimizeProgram(compileRPN(rpn)); }
+    catch (...) { return samples; }
+    CurveEvaluator curve(program, env);
+
+    std::vector<double> xs;
+    xs.reserve(samples.capacity());
+    for (double x = xMin; x <= xMax; x += step) xs.push_back(x);
+    std::vector<double> ys(xs.size());
+    std::vector<uint8_t> invalid(xs.size());
+    size_t invalidCount = curve.evaluate(xs.data(), ys.data(), xs.size(), invalid.data());
+    for (size_t i = 0; i < xs.size(); ++i) {
+        if (invalidCount && invalid[i]) continue;
+        samples.emplace_back(static_cast<float>(xs[i]), static_cast<float>(ys[i]));
     }
     return samples;
 }
-static sf::Vector2f lerpPoint(double x1, double y1, double x2, double y2, double t) {
-    return sf::Vector2f(static_cast<float>(x1 + (x2 - x1) * t), static_cast<float>(y1 + (y2 - y1) * t));
+void decimateColumns(std::vector<sf::Vertex>& strip, bool byRow) {
+    if (strip.size() < 8) return;
+    auto column = [&](size_t i) { return std::floor(byRow ? strip[i].position.y : strip[i].position.x); };
+    auto value = [&](size_t i) { return byRow ? strip[i].position.x : strip[i].position.y; };
+    size_t outSize = 0;
+    size_t begin = 0;
+    while (begin < strip.size()) {
+        float col = column(begin);
+        size_t end = begin + 1, lo = begin, hi = begin;
+        for (; end < strip.size() && column(end) == col; ++end) {
+            if (value(end) < value(lo)) lo = end;
+            if (value(end) > value(hi)) hi = end;
+        }
+        size_t keep[4] = { begin, std::min(lo, hi), std::max(lo, hi), end - 1 };
+        for (int k = 0; k < 4; ++k) {
+            if (k > 0 && keep[k] == keep[k - 1]) continue;
+            strip[outSize++] = strip[keep[k]];
+        }
+        begin = end;
+    }
+    strip.resize(outSize);
 }
-static std::vector<std::vector<sf::Vector2f>> marchingSquares(const std::vector<std::vector<double>>& grid,
-    double x0, double y0, double dx, double dy, double iso = 0.0)
+// Turns (t, f(t)) samples into screen-space polylines, breaking at NaN samples. With swapAxes the
+// samples come from x = f(y), so t is the world y coordinate and f(t) the world x coordinate.
+static void appendCurve(std::vector<std::vector<sf::Vertex>>& segmentsOut, const std::vector<sf::Vector2f>& samples,
+    sf::Color color, double scale, double centerX, double centerY, bool swapAxes)
 {
-    int ny = (int)grid.size();
-    if (ny == 0) return {};
-    int nx = (int)grid[0].size();
-    if (nx == 0) return {};
-
-    std::vector<std::vector<sf::Vector2f>> segments;
-    segments.reserve((nx - 1) * (ny - 1) / 4);
-
-    for (int j = 0; j < ny - 1; ++j) {
-        for (int i = 0; i < nx - 1; ++i) {
-            double v[4];
-            v[0] = grid[j][i]; 
-            v[1] = grid[j][i + 1];  
-            v[2] = grid[j + 1][i + 1]; 
-            v[3] = grid[j + 1][i];  
-            int mask = 0;
-            if (v[0] >= iso) mask |= 1;
-            if (v[1] >= iso) mask |= 2;
-            if (v[2] >= iso) mask |= 4;
-            if (v[3] >= iso) mask |= 8;
-            if (mask == 0 || mask == 15) continue;
-
-            auto interp = [&](int a, int b, double xa, double ya, double xb, double yb) {
-                double va = (a == 0 ? v[0] : (a == 1 ? v[1] : (a == 2 ? v[2] : v[3])));
-                double vb = (b == 0 ? v[0] : (b == 1 ? v[1] : (b == 2 ? v[2] : v[3])));
-                double t = 0.0;
-                if (std::isfinite(va) && std::isfinite(vb) && vb != va) t = (iso - va) / (vb - va);
-                return lerpPoint(xa, ya, xb, yb, t);
-                };
-
-            double xL = x0 + i * dx;
-            double xR = x0 + (i + 1) * dx;
-            double yT = y0 + j * dy;
-            double yB = y0 + (j + 1) * dy;
-
-            std::vector<sf::Vector2f> pts;
-            switch (mask) {
-            case 1: case 14: {
-                pts.push_back(interp(0, 1, xL, yT, xR, yT));
-                pts.push_back(interp(0, 3, xL, yT, xL, yB));
-                break;
-            }
-            case 2: case 13: {
-                pts.push_back(interp(0, 1, xL, yT, xR, yT));
-                pts.push_back(interp(1, 2, xR, yT, xR, yB));
-                break;
-            }
-            case 3: case 12: {
-                pts.push_back(interp(1, 2, xR, yT, xR, yB));
-                pts.push_back(interp(0, 3, xL, yT, xL, yB));
-                break;
-            }
-            case 4: case 11: {
-                pts.push_back(interp(2, 3, xR, yB, xL, yB));
-                pts.push_back(interp(1, 2, xR, yT, xR, yB));
-                break;
-            }
-            case 5: case 10: {
-                pts.push_back(interp(0, 1, xL, yT, xR, yT));
-                pts.push_back(interp(2, 3, xR, yB, xL, yB));
-                break;
-            }
-            case 6: case 9: {
-                pts.push_back(interp(0, 3, xL, yT, xL, yB));
-                pts.push_back(interp(2, 3, xR, yB, xL, yB));
-                break;
-            }
-            case 7: case 8: {
-                pts.push_back(interp(0, 3, xL, yT, xL, yB));
-                pts.push_back(interp(1, 2, xR, yT, xR, yB));
-                break;
-            }
-            default: break;
-            }
-
-            if (!pts.empty()) segments.push_back(std::move(pts));
-        }
+    std::vector<sf::Vertex> curr;
+    curr.reserve(1024);
+
+    auto flush = [&]() {
+        decimateColumns(curr, swapAxes);
+        if (curr.size() >= 2) segmentsOut.push_back(std::move(curr));
+        curr.clear();
+    };
+    for (auto& p : samples) {
+        if (!std::isfinite(p.y)) { flush(); continue; }
+        double x = swapAxes ? p.y : p.x;
+        double y = swapAxes ? p.x : p.y;
+        float sx = static_cast<float>(centerX + x * scale);
+        float sy = static_cast<float>(centerY - y * scale);
+        curr.emplace_back(sf::Vector2f(sx, sy), color);
     }
-    return segments;
+    flush();
 }
-std::vector<std::vector<sf::Vertex>> computeGraphFromRPN(
-    const std::vector<Token>& rpn,
-    sf::Color color,
-    double scale,
-    double xMin, double xMax, double step,
-    double centerX, double centerY,
-    int screenWidth, int screenHeight,
-    const std::unordered_map<std::string, double>* env,
-    std::atomic<bool>* cancel)
+
+ProgressiveGraph::ProgressiveGraph(const std::vector<Token>& rpn, sf::Color color, double scale, double xMin, double xMax,
+    double centerX, double centerY, int screenWidth, int screenHeight,
+    const std::unordered_map<std::string, double>* env, ThreadPool* pool, TileCache* tiles, ImplicitMethod implicit)
+    : color_(color), scale_(scale), centerX_(centerX), centerY_(centerY), pool_(pool)
 {
-    std::vector<std::vector<sf::Vertex>> segmentsOut;
-    if (rpn.empty()) return segmentsOut;
-    if (rpnUsesY(rpn) && screenWidth > 0 && screenHeight > 0) {
-        double worldXMin = (0.0 - centerX) / scale;
-        double worldXMax = ((double)screenWidth - centerX) / scale;
-        double worldYMax = centerY / scale;
-        double worldYMin = (centerY - screenHeight) / scale;
-
-        int nx = std::min(300, std::max(8, screenWidth / 2));
-        int ny = std::min(300, std::max(8, screenHeight / 2));
-        double dx = (worldXMax - worldXMin) / (nx - 1);
-        double dy = (worldYMax - worldYMin) / (ny - 1);
-
-        std::vector<std::vector<double>> grid(ny, std::vector<double>(nx, NAN));
-        for (int j = 0; j < ny; ++j) {
-            for (int i = 0; i < nx; ++i) {
-                double wx = worldXMin + i * dx;
-                double wy = worldYMin + j * dy;
-                try {
-                    if (env) {
-                        auto local = *env; local["x"] = wx; local["y"] = wy;
-                        grid[j][i] = evaluateRPNEnv(rpn, local);
-                    }
-                    else {
-                        grid[j][i] = evaluateRPNXY(rpn, wx, wy);
+    if (rpn.empty()) return;
+    const bool haveScreen = screenWidth > 0 && screenHeight > 0;
+    Program optimized;
+    SolvedEquation solved;
+    try {
+        optimized = optimizeProgram(compileRPN(rpn));
+        if (rpnUsesY(rpn) && haveScreen) solved = solveEquation(optimized, env);
+        else solved = { EquationForm::ExplicitY, optimized };
+    }
+    catch (...) { return; }
+
+    double worldXMin = xMin, worldXMax = xMax;
+    double worldYMin = -INFINITY, worldYMax = INFINITY;
+    if (haveScreen) {
+        worldXMin = (0.0 - centerX) / scale;
+        worldXMax = ((double)screenWidth - centerX) / scale;
+        worldYMax = centerY / scale;
+        worldYMin = (centerY - screenHeight) / scale;
+    }
+
+    // y = f(x) and x = f(y) are plotted as 1D curves, only genuine relations go to the grid
+    if (solved.form != EquationForm::Implicit) {
+        swapAxes_ = solved.form == EquationForm::ExplicitX;
+        SampleWindow w{ xMin, xMax, worldYMin, worldYMax, scale };
+        if (swapAxes_) w = { worldYMin, worldYMax, worldXMin, worldXMax, scale };
+        curve_ = std::make_unique<CurveEvaluator>(solved.function, env);
+        sampler_ = std::make_unique<CurveSampler>(*curve_, w, tiles);
+        levelCount_ = 2;
+        return;
+    }
+
+    HoistedProgram hoisted = hoistInvariants(optimized);
+    vars_ = bindVariables(hoisted.body, env);
+    evaluateInvariants(hoisted, vars_);
+    if (implicit == ImplicitMethod::Quadtree) {
+        tree_ = std::make_unique<ImplicitQuadtree>(hoisted.body, vars_, worldXMin, worldXMax, worldYMin, worldYMax, scale);
+        levelCount_ = 2;
+        return;
+    }
+
+    // the full grid is a whole number of coarse cells wide and high
+    nx_ = std::min(300, std::max(8, screenWidth / 2));
+    ny_ = std::min(300, std::max(8, screenHeight / 2));
+    nx_ = (nx_ - 2) / COARSE_STRIDE * COARSE_STRIDE + COARSE_STRIDE + 1;
+    ny_ = (ny_ - 2) / COARSE_STRIDE * COARSE_STRIDE + COARSE_STRIDE + 1;
+    dx_ = ((double)screenWidth / scale) / (nx_ - 1);
+    dy_ = ((double)screenHeight / scale) / (ny_ - 1);
+    // nodes sit on multiples of the spacing, so views panned at the same scale share them
+    ix0_ = (int64_t)std::floor(worldXMin / dx_);
+    iy0_ = (int64_t)std::floor(worldYMin / dy_);
+    if ((double)(ix0_ + nx_ - 1) * dx_ < worldXMax) nx_ += COARSE_STRIDE;
+    if ((double)(iy0_ + ny_ - 1) * dy_ < worldYMax) ny_ += COARSE_STRIDE;
+    x0_ = (double)ix0_ * dx_;
+    y0_ = (double)iy0_ * dy_;
+    if (implicit == ImplicitMethod::Trace) {
+        tracer_ = std::make_unique<ContourTracer>(hoisted.body, vars_, ix0_, iy0_, dx_, dy_, nx_, ny_);
+        levelCount_ = 1;
+        return;
+    }
+
+    programKey_ = programHash(hoisted.body);
+    envKey_ = frameHash(vars_);
+    grid_ = separateGrid(hoisted.body);
+    vars_.resize(grid_.body.variables.size(), 0.0);
+    if (jitPreferred(grid_.body)) jit_ = compileJit(grid_.body);
+
+    // x-only parts once per column
+    std::vector<double> xs(nx_);
+    for (int i = 0; i < nx_; ++i) xs[i] = (double)(ix0_ + i) * dx_;
+    columnValues_.resize(grid_.columns.size() * nx_);
+    for (size_t k = 0; k < grid_.columns.size(); ++k) {
+        evaluateProgramBatch(grid_.columns[k], xs.data(), nullptr, vars_.data(), columnValues_.data() + k * nx_, nx_);
+    }
+
+    values_.assign((size_t)nx_ * ny_, NAN);
+    rowStride_.assign(ny_, 0);
+    levelCount_ = (nx_ - 1) / COARSE_STRIDE >= 8 && (ny_ - 1) / COARSE_STRIDE >= 8 ? 2 : 1;
+}
+
+bool ProgressiveGraph::reuse(const ProgressiveGraph& previous) {
+    if (values_.empty() || previous.values_.empty() || level_ != 0 || !previous.done()) return false;
+    if (previous.dx_ != dx_ || previous.dy_ != dy_ || previous.programKey_ != programKey_ || previous.envKey_ != envKey_) return false;
+    // the block of nodes both grids share, in this grid's indices
+    int64_t di = ix0_ - previous.ix0_, dj = iy0_ - previous.iy0_;
+    int64_t i0 = std::max<int64_t>(0, -di), i1 = std::min<int64_t>(nx_, previous.nx_ - di);
+    int64_t j0 = std::max<int64_t>(0, -dj), j1 = std::min<int64_t>(ny_, previous.ny_ - dj);
+    if (i0 >= i1 || j0 >= j1) return false;
+    for (int64_t j = j0; j < j1; ++j) {
+        const double* from = previous.values_.data() + (j + dj) * previous.nx_ + di;
+        std::copy(from + i0, from + i1, values_.data() + j * nx_ + i0);
+    }
+    reusedColumns_ = { (int)i0, (int)i1 };
+    reusedRows_ = { (int)j0, (int)j1 };
+    // only the exposed strips are left, so there is nothing to preview
+    levelCount_ = 1;
+    return true;
+}
+
+bool ProgressiveGraph::refine(const StopToken& stop) {
+    if (done()) return true;
+    bool finished = curve_ ? refineCurve(stop) : tree_ ? refineTree(stop) : tracer_ ? refineTrace(stop) : refineGrid(stop);
+    if (finished) ++level_;
+    return finished;
+}
+
+bool ProgressiveGraph::refineCurve(const StopToken& stop) {
+    size_t budget = level_ + 1 < levelCount_ ? TILE_SAMPLE_BUDGET / 4 : TILE_SAMPLE_BUDGET;
+    sampler_->refine(budget, pool_, &stop);
+    if (stop.cancelled()) return false;
+    // an interrupted pass still leaves a valid, just coarser, curve
+    segments_.clear();
+    appendCurve(segments_, sampler_->samples(), color_, scale_, centerX_, centerY_, swapAxes_);
+    if (sampler_->converged()) level_ = levelCount_ - 1;
+    return !stop.stopRequested();
+}
+
+// the columns of a grid row evaluated in one batch, with their x and LoadColumn inputs gathered
+struct GridColumns {
+    std::vector<int> index;
+    std::vector<double> xs;
+    std::vector<double> columnValues;
+    std::vector<const double*> columns;
+};
+
+template <class Keep>
+static GridColumns gatherColumns(int nx, int64_t ix0, double dx, const std::vector<double>& columnValues, size_t columnCount, Keep keep)
+{
+    GridColumns g;
+    for (int i = 0; i < nx; ++i) {
+        if (keep(i)) g.index.push_back(i);
+    }
+    size_t n = g.index.size();
+    g.xs.resize(n);
+    g.columnValues.resize(columnCount * n);
+    for (size_t m = 0; m < n; ++m) {
+        g.xs[m] = (double)(ix0 + g.index[m]) * dx;
+        for (size_t k = 0; k < columnCount; ++k) g.columnValues[k * n + m] = columnValues[k * nx + g.index[m]];
+    }
+    for (size_t k = 0; k < columnCount; ++k) g.columns.push_back(g.columnValues.data() + k * n);
+    return g;
+}
+
+bool ProgressiveGraph::refineGrid(const StopToken& stop) {
+    const int stride = level_ + 1 < levelCount_ ? COARSE_STRIDE : 1;
+    const size_t columnCount = grid_.columns.size();
+    GridColumns all = gatherColumns(nx_, ix0_, dx_, columnValues_, columnCount, [&](int i) { return i % stride == 0; });
+    // rows the coarse level already covered only miss the columns in between
+    GridColumns gaps = gatherColumns(nx_, ix0_, dx_, columnValues_, columnCount, [](int i) { return i % COARSE_STRIDE != 0; });
+    // and rows reused from a panned grid those outside the reused block
+    GridColumns exposed = gatherColumns(nx_, ix0_, dx_, columnValues_, columnCount,
+        [&](int i) { return i < reusedColumns_.first || i >= reusedColumns_.second; });
+
+    // rows, and then contour cells, in fixed bands of rows, one task each
+    std::vector<int> rows;
+    for (int j = 0; j < ny_; j += stride) rows.push_back(j);
+    int bands = ((int)rows.size() + GRID_BAND_ROWS - 1) / GRID_BAND_ROWS;
+    {
+        TaskGroup group(pool_);
+        for (int b = 0; b < bands; ++b) {
+            group.run([&, b]() {
+                if (stop.stopRequested()) return;
+                std::vector<double> bandVars = vars_;
+                std::vector<double> ys, out;
+                for (int r = b * GRID_BAND_ROWS; r < std::min((int)rows.size(), (b + 1) * GRID_BAND_ROWS); ++r) {
+                    int j = rows[r];
+                    if (rowStride_[j] != 0 && rowStride_[j] <= stride) continue;
+                    bool reused = j >= reusedRows_.first && j < reusedRows_.second;
+                    const GridColumns& cols = rowStride_[j] == COARSE_STRIDE ? gaps : reused ? exposed : all;
+                    rowStride_[j] = stride;
+                    if (cols.index.empty()) continue;
+                    double wy = (double)(iy0_ + j) * dy_;
+                    for (size_t k = 0; k < grid_.rows.size(); ++k) {
+                        bandVars[grid_.firstRow + k] = evaluateProgram(grid_.rows[k], 0.0, wy, bandVars.data());
                     }
+                    size_t n = cols.index.size();
+                    ys.assign(n, wy);
+                    out.resize(n);
+                    if (jit_.isNative()) jit_.evaluateBatch(cols.xs.data(), ys.data(), bandVars.data(), out.data(), n, nullptr, cols.columns.data());
+                    else evaluateProgramBatch(grid_.body, cols.xs.data(), ys.data(), bandVars.data(), out.data(), n, nullptr, cols.columns.data());
+                    double* row = values_.data() + (size_t)j * nx_;
+                    for (size_t m = 0; m < n; ++m) row[cols.index[m]] = out[m];
                 }
-                catch (...) { grid[j][i] = NAN; }
-            }
+            });
         }
+        group.wait();
+    }
+    // an interrupted level keeps the segments of the previous one
+    if (stop.stopRequested()) return false;
 
-        auto segs = marchingSquares(grid, worldXMin, worldYMin, dx, dy, 0.0);
-        segmentsOut.reserve(segs.size());
-        for (auto& s : segs) {
-            std::vector<sf::Vertex> segV;
-            segV.reserve(s.size());
-            for (auto& p : s) {
-                float sx = static_cast<float>(centerX + p.x * scale);
-                float sy = static_cast<float>(centerY - p.y * scale);
-                segV.emplace_back(sf::Vector2f(sx, sy), color);
-            }
-            if (segV.size() >= 2) segmentsOut.push_back(std::move(segV));
+    // contour of the lattice this level evaluated
+    const int latticeX = (nx_ - 1) / stride + 1, latticeY = (int)rows.size();
+    std::vector<std::vector<sf::Vector2f>> bandEdges(bands);
+    std::vector<std::vector<uint32_t>> bandEdgeIds(bands);
+    {
+        TaskGroup group(pool_);
+        for (int b = 0; b < bands; ++b) {
+            group.run([&, b]() {
+                if (stop.stopRequested()) return;
+                bandEdges[b].reserve((size_t)latticeX * 8);
+                bandEdgeIds[b].reserve((size_t)latticeX * 8);
+                marchingSquares(values_.data(), latticeX, latticeY, (ptrdiff_t)stride * nx_, stride, x0_, y0_, dx_ * stride, dy_ * stride,
+                    b * GRID_BAND_ROWS, (b + 1) * GRID_BAND_ROWS, bandEdges[b], bandEdgeIds[b], 0.0);
+            });
         }
+        group.wait();
+    }
+    if (stop.stopRequested()) return false;
 
-        return segmentsOut;
+    // bands meet on shared rows of edges, so their segments are joined together
+    std::vector<sf::Vector2f> edges;
+    std::vector<uint32_t> edgeIds;
+    for (int b = 0; b < bands; ++b) {
+        edges.insert(edges.end(), bandEdges[b].begin(), bandEdges[b].end());
+        edgeIds.insert(edgeIds.end(), bandEdgeIds[b].begin(), bandEdgeIds[b].end());
     }
-    auto samples = computeWorldSamplesFromRPN(rpn, xMin, xMax, step, env);
-    if (samples.empty()) return segmentsOut;
+    setPolylines(stitchSegments(edges, edgeIds, (size_t)latticeX * latticeY * 2));
+    return true;
+}
 
-    const double MAX_JUMP = std::max(10.0, 10.0 / (scale / 5.0));
-    std::vector<sf::Vertex> curr;
-    curr.reserve(1024);
-    double prevY = 0.0;
-    bool havePrev = false;
+bool ProgressiveGraph::refineTree(const StopToken& stop) {
+    double leafPx = level_ + 1 < levelCount_ ? (double)COARSE_STRIDE : QUADTREE_LEAF_PX;
+    // an interrupted level keeps the segments of the previous one
+    if (!tree_->refine(leafPx, pool_, &stop) || stop.stopRequested()) return false;
+    setPolylines(tree_->contour(pool_));
+    return true;
+}
 
-    for (auto& p : samples) {
-        double x = p.x;
-        double y = p.y;
-        if (!std::isfinite(y)) { if (curr.size() >= 2) segmentsOut.push_back(std::move(curr)); curr.clear(); havePrev = false; continue; }
+bool ProgressiveGraph::refineTrace(const StopToken& stop) {
+    auto lines = tracer_->trace(COARSE_STRIDE, &stop);
+    if (stop.stopRequested()) return false;
+    setPolylines(lines);
+    return true;
+}
 
-        if (havePrev && std::abs(y - prevY) > MAX_JUMP) {
-            if (curr.size() >= 2) segmentsOut.push_back(std::move(curr));
-            curr.clear(); havePrev = false;
+void ProgressiveGraph::setPolylines(const std::vector<std::vector<sf::Vector2f>>& lines) {
+    segments_.clear();
+    segments_.reserve(lines.size());
+    for (auto& line : lines) {
+        std::vector<sf::Vertex> strip;
+        strip.reserve(line.size());
+        for (auto& p : line) {
+            float sx = static_cast<float>(centerX_ + p.x * scale_);
+            float sy = static_cast<float>(centerY_ - p.y * scale_);
+            strip.emplace_back(sf::Vector2f(sx, sy), color_);
         }
-
-        float sx = static_cast<float>(centerX + x * scale);
-        float sy = static_cast<float>(centerY - y * scale);
-        curr.emplace_back(sf::Vector2f(sx, sy), color);
-        prevY = y; havePrev = true;
+        segments_.push_back(std::move(strip));
     }
-    if (curr.size() >= 2) segmentsOut.push_back(std::move(curr));
-    return segmentsOut;
+}
+
+std::vector<std::vector<sf::Vertex>> computeGraphFromRPN(
+    const std::vector<Token>& rpn,
+    sf::Color color,
+    double scale,
+    double xMin, double xMax,
+    double centerX, double centerY,
+    int screenWidth, int screenHeight,
+    const std::unordered_map<std::string, double>* env,
+    std::atomic<bool>* cancel,
+    ThreadPool* pool,
+    std::chrono::steady_clock::time_point deadline,
+    TileCache* tiles,
+    ImplicitMethod implicit)
+{
+    StopToken stop{ cancel, deadline };
+    if (stop.cancelled()) return {};
+    ProgressiveGraph graph(rpn, color, scale, xMin, xMax, centerX, centerY, screenWidth, screenHeight, env, pool, tiles, implicit);
+    while (!graph.done() && graph.refine(stop)) {}
+    if (stop.cancelled()) return {};
+    return graph.segments();
 }
 std::vector<std::vector<sf::Vertex>> computeGraph(const std::string& expr,
     sf::Color color, double scale,
-    double xMin, double xMax, double step,
+    double xMin, double xMax,
     double centerX, double centerY,
     int screenWidth, int screenHeight,
     const std::unordered_map<std::string, double>* env) {
     auto tokens = tokenize(expr);
     auto rpn = shuntingYard(tokens);
-    std::atomic<bool> cancelFlag(false);
-    return computeGraphFromRPN(rpn, color, scale, xMin, xMax, step, centerX, centerY, screenWidth, screenHeight, env, &cancelFlag);
+    return computeGraphFromRPN(rpn, color, scale, xMin, xMax, centerX, centerY, screenWidth, screenHeight, env);
 }
 void drawSegments(sf::RenderWindow& window, const std::vector<std::vector<sf::Vertex>>& segments) {
     for (const auto& seg : segments) {
@@ -3,9 +3,88 @@
 #include <string>
 #include <vector>
 #include "../tokenizer/tokenizer.h"
+#include "../jit/jit.h"
+#include "../optimizer/hoisting.h"
+#include "../threading/stop_token.h"
+#include "sampler.h"
+#include "contour.h"
 #include <atomic>
+#include <chrono>
+#include <memory>
 #include <unordered_map>
+#include <utility>
 
-std::vector<std::vector<sf::Vertex>> computeGraph(const std::string& expr, sf::Color color = sf::Color::Cyan, double scale = 50.0, double xMin = -8.0, double xMax = 8.0, double step = 0.01, double centerX = 400.0, double centerY = 300.0, int screenWidth = 0, int screenHeight = 0, const std::unordered_map<std::string,double>* env = nullptr);
-std::vector<std::vector<sf::Vertex>> computeGraphFromRPN(const std::vector<Token>& rpn, sf::Color color = sf::Color::Cyan, double scale = 50.0, double xMin = -8.0, double xMax = 8.0, double step = 0.01, double centerX = 400.0, double centerY = 300.0, int screenWidth = 0, int screenHeight = 0, const std::unordered_map<std::string,double>* env = nullptr, std::atomic<bool>* cancel = nullptr);
+class ThreadPool;
+
+// One graph computed in levels of increasing resolution: refine() computes the next level, reusing
+// what the earlier ones evaluated, and segments() holds the last level reached. Explicit curves
+// get a quarter of the sample budget first, and their tiles come from and go to `tiles` when
+// given; implicit relations get every 4th grid row and column (75x75 of a 300x300 grid) before
+// the full grid fills in the gaps, and their contour comes out as one polyline per curve. With
+// ImplicitMethod::Quadtree they are subdivided to 4 px cells first, then to QUADTREE_LEAF_PX; with
+// ImplicitMethod::Trace their curves are followed through the cells of the full grid in one level.
+class ProgressiveGraph {
+public:
+    ProgressiveGraph(const std::vector<Token>& rpn, sf::Color color, double scale, double xMin, double xMax,
+        double centerX, double centerY, int screenWidth, int screenHeight,
+        const std::unordered_map<std::string, double>* env, ThreadPool* pool, TileCache* tiles = nullptr,
+        ImplicitMethod implicit = ImplicitMethod::Grid);
+
+    // Before the first refine(): takes the grid values a finished graph of the same relation at the
+    // same scale computed for a panned view, so only the strips scrolled into view are evaluated.
+    // False, changing nothing, when there is nothing to take.
+    bool reuse(const ProgressiveGraph& previous);
+
+    // false when stop interrupted the level; calling again resumes it
+    bool refine(const StopToken& stop);
+    bool done() const { return level_ >= levelCount_; }
+    int level() const { return level_; }
+    const std::vector<std::vector<sf::Vertex>>& segments() const { return segments_; }
+    // the grid's node values, row-major, NaN where not evaluated yet; empty off the grid
+    const std::vector<double>& gridValues() const { return values_; }
+
+private:
+    bool refineCurve(const StopToken& stop);
+    bool refineGrid(const StopToken& stop);
+    bool refineTree(const StopToken& stop);
+    bool refineTrace(const StopToken& stop);
+    void setPolylines(const std::vector<std::vector<sf::Vector2f>>& lines);
+
+    sf::Color color_;
+    double scale_, centerX_, centerY_;
+    ThreadPool* pool_;
+    int level_ = 0;
+    int levelCount_ = 0;
+    std::vector<std::vector<sf::Vertex>> segments_;
+
+    // y = f(x) or x = f(y)
+    std::unique_ptr<CurveEvaluator> curve_;
+    std::unique_ptr<CurveSampler> sampler_;
+    bool swapAxes_ = false;
+
+    // implicit relations, on a quadtree
+    std::unique_ptr<ImplicitQuadtree> tree_;
+    // or traced along the grid's nodes
+    std::unique_ptr<ContourTracer> tracer_;
+
+    // or on a grid whose row j has been evaluated at every rowStride_[j]-th column
+    GridProgram grid_;
+    JitProgram jit_;
+    std::vector<double> vars_;
+    int nx_ = 0, ny_ = 0;
+    int64_t ix0_ = 0, iy0_ = 0;  // world position of node (0, 0) in units of dx_, dy_
+    double x0_ = 0.0, y0_ = 0.0, dx_ = 0.0, dy_ = 0.0;
+    uint64_t programKey_ = 0, envKey_ = 0;
+    std::pair<int, int> reusedColumns_{ 0, 0 }, reusedRows_{ 0, 0 };
+    std::vector<double> columnValues_;
+    std::vector<double> values_;  // row-major, nx_ per row
+    std::vector<int> rowStride_;
+};
+
+// Keeps the first, last, lowest and highest vertex of each run falling in one pixel column (pixel row
+// when byRow), in their original order. A line strip through them rasterizes the same as the full run.
+void decimateColumns(std::vector<sf::Vertex>& strip, bool byRow);
+
+std::vector<std::vector<sf::Vertex>> computeGraph(const std::string& expr, sf::Color color = sf::Color::Cyan, double scale = 50.0, double xMin = -8.0, double xMax = 8.0, double centerX = 400.0, double centerY = 300.0, int screenWidth = 0, int screenHeight = 0, const std::unordered_map<std::string,double>* env = nullptr);
+std::vector<std::vector<sf::Vertex>> computeGraphFromRPN(const std::vector<Token>& rpn, sf::Color color = sf::Color::Cyan, double scale = 50.0, double xMin = -8.0, double xMax = 8.0, double centerX = 400.0, double centerY = 300.0, int screenWidth = 0, int screenHeight = 0, const std::unordered_map<std::string,double>* env = nullptr, std::atomic<bool>* cancel = nullptr, ThreadPool* pool = nullptr, std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max(), TileCache* tiles = nullptr, ImplicitMethod implicit = ImplicitMethod::Grid);
 std::vector<sf::Vector2f> computeWorldSamplesFromRPN(const std::vector<Token>& rpn, double xMin = -8.0, double xMax = 8.0, double step = 0.01, const std::unordered_map<std::string,double>* env = nullptr);
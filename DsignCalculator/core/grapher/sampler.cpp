@@ -0,0 +1,314 @@
+#include "sampler.h"
+#include "../evaluator/evaluator.h"
+#include <algorithm>
+
+constexpr double INITIAL_SPACING_PX = 4.0;
+constexpr double MIN_SPACING_PX = 1.0 / 32.0;
+constexpr double BREAK_JUMP_PX = 8.0;
+constexpr int64_t MAX_TILES = 64;
+
+CurveEvaluator::CurveEvaluator(const Program& optimized, const std::unordered_map<std::string, double>* env)
+    : hoisted_(hoistInvariants(optimized)) {
+    vars_ = bindVariables(hoisted_.body, env);
+    evaluateInvariants(hoisted_, vars_);
+    if (jitPreferred(hoisted_.body)) jit_ = compileJit(hoisted_.body);
+}
+
+size_t CurveEvaluator::evaluate(const double* ts, double* out, size_t n, uint8_t* invalid) const {
+    if (jit_.isNative()) return jit_.evaluateBatch(ts, nullptr, vars_.data(), out, n, invalid);
+    return evaluateProgramBatch(hoisted_.body, ts, nullptr, vars_.data(), out, n, invalid);
+}
+
+// whether a child interval between values a and b is worth another midpoint
+static bool childWantsSplit(double a, double b, bool parentDeviates) {
+    bool fa = std::isfinite(a), fb = std::isfinite(b);
+    if (fa != fb) return true;
+    return fa && parentDeviates;
+}
+
+AdaptiveCurve::AdaptiveCurve(const SampleWindow& w, double initialStep, size_t budget) : w_(w), budget_(budget) {
+    if (!(w.tMax > w.tMin) || !(w.pixelsPerUnit > 0.0)) { converged_ = true; return; }
+    double spacing = std::max(initialStep, INITIAL_SPACING_PX / w.pixelsPerUnit);
+    size_t n0 = (size_t)std::ceil((w.tMax - w.tMin) / spacing) + 1;
+    n0 = std::max<size_t>(2, std::min(n0, budget / 2));
+    pts_.resize(n0);
+    unevaluated_.resize(n0);
+    for (size_t i = 0; i < n0; ++i) {
+        pts_[i] = { w.tMin + (w.tMax - w.tMin) * (double)i / (double)(n0 - 1), NAN, i + 1 < n0 };
+        unevaluated_[i] = i;
+    }
+    pts_[n0 - 1].t = w.tMax;
+}
+
+AdaptiveCurve::AdaptiveCurve(const SampleWindow& w, const std::vector<Point>& seed, double seedPixelsPerUnit, size_t budget)
+    : w_(w), budget_(budget) {
+    if (!(w.tMax > w.tMin) || !(w.pixelsPerUnit > 0.0)) { converged_ = true; return; }
+    // splitting stops at the grid spacing, not half of it
+    maxWidth_ = 1.5 * INITIAL_SPACING_PX / w.pixelsPerUnit;
+    const bool recheck = seedPixelsPerUnit < w.pixelsPerUnit;
+    auto lo = std::lower_bound(seed.begin(), seed.end(), w.tMin, [](const Point& p, double t) { return p.t < t; });
+    auto hi = std::upper_bound(seed.begin(), seed.end(), w.tMax, [](double t, const Point& p) { return t < p.t; });
+    if (lo == hi || lo->t != w.tMin) {
+        unevaluated_.push_back(pts_.size());
+        pts_.push_back({ w.tMin, NAN, true });
+    }
+    for (auto it = lo; it != hi; ++it) pts_.push_back({ it->t, it->v, recheck });
+    if (pts_.back().t != w.tMax) {
+        pts_.back().split = true;
+        unevaluated_.push_back(pts_.size());
+        pts_.push_back({ w.tMax, NAN, false });
+    }
+    pts_.back().split = false;
+}
+
+void AdaptiveCurve::refine(const CurveEvaluator& f, size_t passBudget, const StopToken* stop) {
+    if (converged_) return;
+    passBudget = std::min(passBudget, budget_);
+    const double ppu = w_.pixelsPerUnit;
+    const double minWidth = MIN_SPACING_PX / ppu;
+
+    std::vector<double> ts, vs;
+    if (!unevaluated_.empty()) {
+        // the initial grid is evaluated whatever the pass budget
+        if (stop && stop->cancelled()) return;
+        ts.resize(unevaluated_.size());
+        vs.resize(unevaluated_.size());
+        for (size_t k = 0; k < unevaluated_.size(); ++k) ts[k] = pts_[unevaluated_[k]].t;
+        f.evaluate(ts.data(), vs.data(), ts.size());
+        for (size_t k = 0; k < unevaluated_.size(); ++k) pts_[unevaluated_[k]].v = vs[k];
+        used_ += unevaluated_.size();
+        unevaluated_.clear();
+    }
+
+    // one batch of midpoints per level; each level at most doubles the sample count
+    std::vector<size_t> candidates;
+    std::vector<Sample> next;
+    while (used_ < passBudget) {
+        if (stop && stop->stopRequested()) return;
+        candidates.clear();
+        for (size_t i = 0; i + 1 < pts_.size(); ++i) {
+            double width = pts_[i + 1].t - pts_[i].t;
+            if ((pts_[i].split || width > maxWidth_) && width > minWidth) candidates.push_back(i);
+            else pts_[i].split = false;
+        }
+        if (candidates.empty()) { converged_ = true; return; }
+        size_t left = passBudget - used_;
+        if (candidates.size() > left) {
+            // spend what is left on the intervals with the largest screen-space jumps
+            auto jump = [&](size_t i) {
+                double d = std::fabs(pts_[i + 1].v - pts_[i].v);
+                return d == d ? d : INFINITY;
+            };
+            std::nth_element(candidates.begin(), candidates.begin() + left, candidates.end(),
+                [&](size_t a, size_t b) { return jump(a) > jump(b); });
+            candidates.resize(left);
+            std::sort(candidates.begin(), candidates.end());
+        }
+
+        ts.resize(candidates.size());
+        vs.resize(candidates.size());
+        for (size_t k = 0; k < candidates.size(); ++k) ts[k] = 0.5 * (pts_[candidates[k]].t + pts_[candidates[k] + 1].t);
+        f.evaluate(ts.data(), vs.data(), candidates.size());
+        used_ += candidates.size();
+
+        // intervals passed over for lack of budget keep their split flag for the next pass
+        next.clear();
+        next.reserve(pts_.size() + candidates.size());
+        size_t k = 0;
+        for (size_t i = 0; i < pts_.size(); ++i) {
+            if (k < candidates.size() && candidates[k] == i) {
+                const Sample& a = pts_[i];
+                const Sample& b = pts_[i + 1];
+                double m = vs[k];
+                bool deviates = true;
+                if (std::isfinite(a.v) && std::isfinite(b.v) && std::isfinite(m)) {
+                    bool offscreen = (a.v > w_.vMax && b.v > w_.vMax && m > w_.vMax) || (a.v < w_.vMin && b.v < w_.vMin && m < w_.vMin);
+                    deviates = !offscreen && std::fabs(m - 0.5 * (a.v + b.v)) * ppu > TOLERANCE_PX;
+                }
+                next.push_back({ a.t, a.v, childWantsSplit(a.v, m, deviates) });
+                next.push_back({ ts[k], m, childWantsSplit(m, b.v, deviates) });
+                ++k;
+            }
+            else {
+                next.push_back(pts_[i]);
+            }
+        }
+        pts_.swap(next);
+    }
+    if (used_ >= budget_) converged_ = true;
+}
+
+// whether the slope of pts[i, i + 1] is part of the same steep stretch as that of pts[n, n + 1]
+template <class Points>
+static bool slopesAgree(const Points& pts, size_t i, size_t n) {
+    double si = (pts[i + 1].v - pts[i].v) / (pts[i + 1].t - pts[i].t);
+    double sn = (pts[n + 1].v - pts[n].v) / (pts[n + 1].t - pts[n].t);
+    return si * sn > 0.0 && std::fabs(sn) * 8.0 >= std::fabs(si);
+}
+
+// appends the (t, v) pairs of pts[first, last), with a NaN break wherever the curve still jumps
+// several pixels across an interval refined down to minWidth, unlike the intervals on either side
+// of it (poles change sign, steps are flat around the jump). Samples inside a run beyond one side
+// of [vMin, vMax] are left out, as are breaks there.
+template <class Points>
+static void appendWithBreaks(std::vector<sf::Vector2f>& out, const Points& pts, size_t first, size_t last,
+    double minWidth, double ppu, double vMin, double vMax) {
+    auto side = [&](size_t i) { return pts[i].v > vMax ? 1 : pts[i].v < vMin ? -1 : 0; };
+    for (size_t i = first; i < last; ++i) {
+        int s = side(i);
+        bool inner = s != 0 && i > first && i + 1 < last && side(i - 1) == s && side(i + 1) == s;
+        if (!inner) out.emplace_back(static_cast<float>(pts[i].t), static_cast<float>(pts[i].v));
+        if (i + 1 == last) break;
+        double at = pts[i].t, av = pts[i].v;
+        double bt = pts[i + 1].t, bv = pts[i + 1].v;
+        bool offscreen = s != 0 && side(i + 1) == s;
+        if (offscreen || bt - at > 2.0 * minWidth || !(std::fabs(bv - av) * ppu > BREAK_JUMP_PX)) continue;
+        bool continues = (i > first && slopesAgree(pts, i, i - 1)) || (i + 2 < last && slopesAgree(pts, i, i + 1));
+        if (!continues) out.emplace_back(static_cast<float>(0.5 * (at + bt)), NAN);
+    }
+}
+
+std::vector<sf::Vector2f> AdaptiveCurve::samples() const {
+    std::vector<sf::Vector2f> out;
+    if (!unevaluated_.empty()) return out;
+    out.reserve(pts_.size() + 16);
+    appendWithBreaks(out, pts_, 0, pts_.size(), MIN_SPACING_PX / w_.pixelsPerUnit, w_.pixelsPerUnit, w_.vMin, w_.vMax);
+    return out;
+}
+
+std::vector<AdaptiveCurve::Point> AdaptiveCurve::points() const {
+    std::vector<Point> out;
+    if (!unevaluated_.empty()) return out;
+    out.reserve(pts_.size());
+    for (auto& p : pts_) out.push_back({ p.t, p.v });
+    return out;
+}
+
+// Drops every other sample that the chord between its neighbours approximates at ppu, undoing
+// the one subdivision level a zoom level adds.
+static void thinSamples(std::vector<CurvePoint>& pts, double ppu) {
+    if (pts.size() < 3) return;
+    const double maxWidth = 1.5 * INITIAL_SPACING_PX / ppu;
+    size_t outSize = 1;
+    bool dropped = false;
+    for (size_t i = 1; i + 1 < pts.size(); ++i) {
+        const CurvePoint& a = pts[outSize - 1];
+        const CurvePoint& m = pts[i];
+        const CurvePoint& b = pts[i + 1];
+        if (!dropped && std::isfinite(a.v) && std::isfinite(m.v) && std::isfinite(b.v) && b.t - a.t <= maxWidth) {
+            double chord = a.v + (b.v - a.v) * (m.t - a.t) / (b.t - a.t);
+            if (std::fabs(m.v - chord) * ppu <= TOLERANCE_PX) { dropped = true; continue; }
+        }
+        pts[outSize++] = m;
+        dropped = false;
+    }
+    pts[outSize++] = pts.back();
+    pts.resize(outSize);
+}
+
+// Known samples of a tile's interval from the neighbouring zoom levels: its parent, or failing
+// that whichever of its two children are cached, thinned to the tile's density. Empty when there are none.
+static std::vector<CurvePoint> seedFromCache(TileCache& cache, const TileKey& key, double& seedPixelsPerUnit) {
+    std::vector<CurvePoint> seed;
+    TileKey parent = key;
+    parent.zoom = key.zoom - 1;
+    parent.index = key.index >> 1;  // floor(index / 2)
+    if (TileSamples p = cache.peek(parent)) {
+        seedPixelsPerUnit = std::ldexp(1.0, parent.zoom);
+        return *p;
+    }
+    for (int64_t half = 0; half < 2; ++half) {
+        TileKey child = key;
+        child.zoom = key.zoom + 1;
+        child.index = 2 * key.index + half;
+        TileSamples c = cache.peek(child);
+        if (!c || c->empty()) continue;
+        size_t first = !seed.empty() && seed.back().t == c->front().t ? 1 : 0;
+        seed.insert(seed.end(), c->begin() + first, c->end());
+    }
+    thinSamples(seed, std::ldexp(1.0, key.zoom));
+    seedPixelsPerUnit = std::ldexp(1.0, key.zoom);
+    return seed;
+}
+
+CurveSampler::CurveSampler(const CurveEvaluator& f, const SampleWindow& w, TileCache* cache, size_t budget)
+    : f_(f), cache_(cache), budget_(budget), w_(w) {
+    if (!(w.tMax > w.tMin) || !(w.pixelsPerUnit > 0.0)) return;
+    int zoom = (int)std::ceil(std::log2(w.pixelsPerUnit));
+    double width = std::ldexp(TILE_PX, -zoom);
+    while ((std::floor(w.tMax / width) - std::floor(w.tMin / width)) >= (double)MAX_TILES) {
+        --zoom;
+        width = std::ldexp(TILE_PX, -zoom);
+    }
+    tilePixelsPerUnit_ = std::ldexp(1.0, zoom);
+    uint64_t program = f.programKey(), env = f.envKey();
+    for (int64_t i = (int64_t)std::floor(w.tMin / width); i <= (int64_t)std::floor(w.tMax / width); ++i) {
+        Tile tile;
+        tile.key = { program, env, zoom, i };
+        if (cache_) tile.finished = cache_->find(tile.key);
+        if (!tile.finished) {
+            SampleWindow part{ (double)i * width, (double)(i + 1) * width, -INFINITY, INFINITY, tilePixelsPerUnit_ };
+            double seedPixelsPerUnit = 0.0;
+            std::vector<CurvePoint> seed;
+            if (cache_) seed = seedFromCache(*cache_, tile.key, seedPixelsPerUnit);
+            if (seed.empty()) tile.curve.emplace(part, 0.0, TILE_SAMPLE_BUDGET);
+            else tile.curve.emplace(part, seed, seedPixelsPerUnit, TILE_SAMPLE_BUDGET);
+        }
+        tiles_.push_back(std::move(tile));
+    }
+}
+
+void CurveSampler::refine(size_t tileBudget, ThreadPool* pool, const StopToken* stop) {
+    size_t open = 0;
+    for (auto& tile : tiles_) open += !tile.finished;
+    if (open == 0) return;
+    const size_t spent = evaluations();
+    const size_t share = spent < budget_ ? (budget_ - spent) / open : 0;
+
+    TaskGroup group(pool);
+    for (auto& tile : tiles_) {
+        if (tile.finished) continue;
+        const size_t allowed = std::min(tileBudget, tile.curve->evaluations() + share);
+        group.run([&, allowed]() {
+            tile.curve->refine(f_, allowed, stop);
+            if (!tile.curve->converged()) return;
+            tile.finished = std::make_shared<const std::vector<CurvePoint>>(tile.curve->points());
+            tile.evaluations = tile.curve->evaluations();
+            tile.curve.reset();
+            if (cache_) cache_->insert(tile.key, tile.finished);
+        });
+    }
+    group.wait();
+}
+
+size_t CurveSampler::evaluations() const {
+    size_t spent = 0;
+    for (auto& tile : tiles_) spent += tile.finished ? tile.evaluations : tile.curve->evaluations();
+    return spent;
+}
+
+bool CurveSampler::converged() const {
+    for (auto& tile : tiles_) if (!tile.finished) return false;
+    return true;
+}
+
+std::vector<sf::Vector2f> CurveSampler::samples() const {
+    // tiles keep raw samples; breaks depend on the visible range, so they are placed here
+    std::vector<AdaptiveCurve::Point> pts;
+    for (auto& tile : tiles_) {
+        std::vector<AdaptiveCurve::Point> pending;
+        const std::vector<AdaptiveCurve::Point>& part = tile.finished ? *tile.finished : (pending = tile.curve->points());
+        // neighbouring tiles share their boundary sample
+        size_t first = !part.empty() && !pts.empty() ? 1 : 0;
+        pts.insert(pts.end(), part.begin() + first, part.end());
+    }
+    // tiles overhang the window; one sample beyond each end still reaches its edges
+    auto lo = std::lower_bound(pts.begin(), pts.end(), w_.tMin, [](const CurvePoint& p, double t) { return p.t < t; });
+    auto hi = std::upper_bound(pts.begin(), pts.end(), w_.tMax, [](double t, const CurvePoint& p) { return t < p.t; });
+    size_t first = lo == pts.begin() ? 0 : (size_t)(lo - pts.begin()) - 1;
+    size_t last = hi == pts.end() ? pts.size() : (size_t)(hi - pts.begin()) + 1;
+    std::vector<sf::Vector2f> out;
+    out.reserve(last - first + 16);
+    appendWithBreaks(out, pts, first, last, MIN_SPACING_PX / tilePixelsPerUnit_, tilePixelsPerUnit_, w_.vMin, w_.vMax);
+    return out;
+}
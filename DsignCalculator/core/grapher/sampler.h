@@ -0,0 +1,128 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include "../compiler/compiler.h"
+#include "../jit/jit.h"
+#include "../optimizer/hoisting.h"
+#include "../threading/stop_token.h"
+#include "../threading/thread_pool.h"
+#include "tile_cache.h"
+#include <cmath>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Evaluates an optimized single-variable program (its variable read as x) for batches of inputs.
+// Parameters are bound and invariants hoisted once, on construction.
+class CurveEvaluator {
+public:
+    CurveEvaluator(const Program& optimized, const std::unordered_map<std::string, double>* env);
+
+    // out[i] = f(ts[i]); returns the number of non-finite results
+    size_t evaluate(const double* ts, double* out, size_t n, uint8_t* invalid = nullptr) const;
+    // the TileKey program and env fields of f
+    uint64_t programKey() const { return programHash(hoisted_.body); }
+    uint64_t envKey() const { return frameHash(vars_); }
+
+private:
+    HoistedProgram hoisted_;
+    std::vector<double> vars_;
+    JitProgram jit_;
+};
+
+// how far, in px, the chord between two finished samples may stray from f at its midpoint
+constexpr double TOLERANCE_PX = 0.25;
+
+struct SampleWindow {
+    double tMin = 0.0;          // sampled input range
+    double tMax = 0.0;
+    double vMin = -INFINITY;    // visible output range, nothing is refined entirely beyond one side of it
+    double vMax = INFINITY;
+    double pixelsPerUnit = 1.0; // screen scale shared by both axes
+};
+
+// Adaptive sampling of f over one window by recursive midpoint subdivision of a 4 px grid: an
+// interval is split while its midpoint deviates from the chord by more than a quarter pixel, or
+// while only one end is finite, down to 1/32 px. The subdivision is kept between passes, so a
+// later refine() with a larger budget carries on from the samples the earlier ones produced.
+class AdaptiveCurve {
+public:
+    using Point = CurvePoint;
+
+    // `budget` bounds the evaluations of all passes together
+    AdaptiveCurve(const SampleWindow& w, double initialStep, size_t budget);
+    // Starts from samples of f already known, taken at seedPixelsPerUnit, instead of the 4 px grid.
+    // Seeds at a lower density are checked again at this one; gaps wider than the grid are split
+    // regardless, so only what the known samples do not cover is evaluated.
+    AdaptiveCurve(const SampleWindow& w, const std::vector<Point>& seed, double seedPixelsPerUnit, size_t budget);
+
+    // Refines until `passBudget` evaluations have been spent in total, or nothing is left to split.
+    // stop is polled once per subdivision level; a level is either merged whole or not at all.
+    void refine(const CurveEvaluator& f, size_t passBudget, const StopToken* stop = nullptr);
+    bool converged() const { return converged_; }
+    size_t evaluations() const { return used_; }
+
+    // (t, f(t)) in increasing t; a NaN f marks a break, inserted wherever the curve still jumps
+    // several pixels across a fully refined interval (poles, steps) or leaves its domain
+    std::vector<sf::Vector2f> samples() const;
+    // the same samples without breaks
+    std::vector<Point> points() const;
+
+private:
+    struct Sample {
+        double t;
+        double v;
+        bool split;  // the interval from this sample to the next still wants a midpoint
+    };
+
+    SampleWindow w_;
+    size_t budget_;
+    size_t used_ = 0;
+    bool converged_ = false;
+    double maxWidth_ = INFINITY;         // intervals wider than this are split whatever their midpoint
+    std::vector<Sample> pts_;
+    std::vector<size_t> unevaluated_;    // samples refine() evaluates first
+};
+
+constexpr double TILE_PX = 256.0;
+constexpr size_t TILE_SAMPLE_BUDGET = 2048;
+constexpr size_t CURVE_SAMPLE_BUDGET = 16384;
+
+// Samples a curve over the world-space tiles (see TileKey) of zoom level ceil(log2(px per unit))
+// covering the window: one AdaptiveCurve with up to TILE_SAMPLE_BUDGET evaluations per tile,
+// stitched back together. The tiles still sampling share what is left of the curve's budget
+// evenly, so a window of many tiles costs no more than one of a screen's handful; tiles cut short
+// by it stay unfinished and are not cached. Tiles depend neither on the visible range nor on the thread count, so
+// with a cache, finished tiles are reused when the view pans or zooms back to the same level.
+// A tile missing from the cache is seeded from its cached parent or children, so crossing into
+// the next zoom level only samples what the neighbouring level does not already provide; such a
+// tile meets the same tolerance as a fresh one, though not with the same samples.
+class CurveSampler {
+public:
+    // f must outlive the sampler; `budget` bounds the evaluations of all tiles and passes together
+    CurveSampler(const CurveEvaluator& f, const SampleWindow& w, TileCache* cache = nullptr,
+        size_t budget = CURVE_SAMPLE_BUDGET);
+
+    // refines every unfinished tile, on pool (inline when null), to `tileBudget` evaluations or its
+    // share of the curve's budget, whichever is less; tiles that finish are added to the cache
+    void refine(size_t tileBudget, ThreadPool* pool, const StopToken* stop = nullptr);
+    bool converged() const;
+    std::vector<sf::Vector2f> samples() const;
+    // spent by this sampler, cached tiles not counted
+    size_t evaluations() const;
+
+private:
+    struct Tile {
+        TileKey key;
+        TileSamples finished;
+        std::optional<AdaptiveCurve> curve;
+        size_t evaluations = 0;  // spent on a finished tile, 0 when it came from the cache
+    };
+
+    const CurveEvaluator& f_;
+    TileCache* cache_;
+    size_t budget_;
+    SampleWindow w_;
+    double tilePixelsPerUnit_ = 1.0;
+    std::vector<Tile> tiles_;
+};
@@ -0,0 +1,58 @@
+#include "tile_cache.h"
+
+TileSamples TileCache::find(const TileKey& key) {
+    return lookup(key, true);
+}
+
+TileSamples TileCache::peek(const TileKey& key) {
+    return lookup(key, false);
+}
+
+TileSamples TileCache::lookup(const TileKey& key, bool count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        if (count) misses_.fetch_add(1);
+        return nullptr;
+    }
+    if (count) hits_.fetch_add(1);
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return it->second->samples;
+}
+
+void TileCache::insert(const TileKey& key, TileSamples samples) {
+    if (!samples) return;
+    size_t bytes = samples->size() * sizeof(CurvePoint) + sizeof(Entry);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        bytes_ -= it->second->bytes;
+        lru_.erase(it->second);
+        index_.erase(it);
+    }
+    lru_.push_front({ key, std::move(samples), bytes });
+    index_[key] = lru_.begin();
+    bytes_ += bytes;
+    while (bytes_ > budget_ && lru_.size() > 1) {
+        bytes_ -= lru_.back().bytes;
+        index_.erase(lru_.back().key);
+        lru_.pop_back();
+    }
+}
+
+void TileCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    lru_.clear();
+    index_.clear();
+    bytes_ = 0;
+}
+
+size_t TileCache::bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_;
+}
+
+size_t TileCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lru_.size();
+}
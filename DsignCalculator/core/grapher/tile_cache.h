@@ -0,0 +1,76 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// A tile of a sampled curve: (t, f(t)) over one world-space interval, like a slippy-map tile.
+// Tiles of zoom level z are sampled at 2^z px per unit and cover TILE_PX of those pixels each.
+struct TileKey {
+    uint64_t program = 0;  // programHash of the sampled function
+    uint64_t env = 0;      // frameHash of its bound parameters
+    int zoom = 0;
+    int64_t index = 0;     // the tile covers [index, index + 1) * TILE_PX / 2^zoom
+
+    bool operator==(const TileKey& o) const {
+        return program == o.program && env == o.env && zoom == o.zoom && index == o.index;
+    }
+};
+
+struct TileKeyHash {
+    size_t operator()(const TileKey& k) const {
+        uint64_t h = k.program;
+        h = h * 0x9E3779B97F4A7C15ull ^ k.env;
+        h = h * 0x9E3779B97F4A7C15ull ^ (uint32_t)k.zoom;
+        h = h * 0x9E3779B97F4A7C15ull ^ (uint64_t)k.index;
+        return (size_t)(h ^ (h >> 29));
+    }
+};
+
+struct CurvePoint {
+    double t;
+    double v;
+};
+
+// raw samples, without the breaks that depend on the visible range
+using TileSamples = std::shared_ptr<const std::vector<CurvePoint>>;
+
+// Finished tiles, evicted least recently used first once their samples exceed the byte budget.
+// Safe to share between threads.
+class TileCache {
+public:
+    explicit TileCache(size_t byteBudget = 32u << 20) : budget_(byteBudget) {}
+
+    // counts a hit or a miss; a hit becomes the most recently used tile
+    TileSamples find(const TileKey& key);
+    // find() without counting, for lookups of tiles that would merely help
+    TileSamples peek(const TileKey& key);
+    void insert(const TileKey& key, TileSamples samples);
+    void clear();
+
+    size_t hits() const { return hits_.load(); }
+    size_t misses() const { return misses_.load(); }
+    size_t bytes() const;
+    size_t size() const;
+
+private:
+    TileSamples lookup(const TileKey& key, bool count);
+
+    struct Entry {
+        TileKey key;
+        TileSamples samples;
+        size_t bytes;
+    };
+
+    mutable std::mutex mutex_;
+    std::list<Entry> lru_;  // most recently used first
+    std::unordered_map<TileKey, std::list<Entry>::iterator, TileKeyHash> index_;
+    size_t budget_;
+    size_t bytes_ = 0;
+    std::atomic<size_t> hits_{ 0 };
+    std::atomic<size_t> misses_{ 0 };
+};
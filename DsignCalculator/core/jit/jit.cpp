@@ -0,0 +1,356 @@
+#include "jit.h"
+#include "../evaluator/evaluator.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <vector>
+
+#ifdef JIT_X64
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#endif
+
+JitProgram::~JitProgram() { release(); }
+
+JitProgram::JitProgram(JitProgram&& other) noexcept
+    : program_(std::move(other.program_)), fn_(other.fn_), memory_(other.memory_), size_(other.size_) {
+    other.fn_ = nullptr; other.memory_ = nullptr; other.size_ = 0;
+}
+
+JitProgram& JitProgram::operator=(JitProgram&& other) noexcept {
+    if (this != &other) {
+        release();
+        program_ = std::move(other.program_);
+        fn_ = other.fn_; memory_ = other.memory_; size_ = other.size_;
+        other.fn_ = nullptr; other.memory_ = nullptr; other.size_ = 0;
+    }
+    return *this;
+}
+
+void JitProgram::release() {
+#ifdef JIT_X64
+    if (memory_) {
+#ifdef _WIN32
+        VirtualFree(memory_, 0, MEM_RELEASE);
+#else
+        munmap(memory_, size_);
+#endif
+    }
+#endif
+    fn_ = nullptr; memory_ = nullptr; size_ = 0;
+}
+
+size_t JitProgram::evaluateBatch(const double* xs, const double* ys, const double* vars, double* out, size_t n, uint8_t* invalid,
+    const double* const* columns) const {
+    if (!fn_) return evaluateProgramBatch(program_, xs, ys, vars, out, n, invalid, columns);
+    static const double zero = 0.0;
+    JitArgs args;
+    args.xs = xs ? xs : &zero;
+    args.ys = ys ? ys : &zero;
+    args.vars = vars;
+    args.out = out;
+    args.n = n;
+    args.xStride = xs ? sizeof(double) : 0;
+    args.yStride = ys ? sizeof(double) : 0;
+    args.columns = columns;
+    fn_(&args);
+    return markInvalid(out, n, invalid);
+}
+
+double JitProgram::evaluate(double x, double y, const double* vars) const {
+    if (!fn_) return evaluateProgram(program_, x, y, vars);
+    double out = 0.0;
+    JitArgs args{ &x, &y, vars, &out, 1, 0, 0, nullptr };
+    fn_(&args);
+    return out;
+}
+
+#ifdef JIT_X64
+
+static double jitSin(double a) { return std::sin(a); }
+static double jitCos(double a) { return std::cos(a); }
+static double jitTan(double a) { return std::tan(a); }
+static double jitAsin(double a) { return std::asin(a); }
+static double jitAcos(double a) { return std::acos(a); }
+static double jitAtan(double a) { return std::atan(a); }
+static double jitLog(double a) { return std::log(a); }
+static double jitExp(double a) { return std::exp(a); }
+static double jitPow(double a, double b) { return std::pow(a, b); }
+
+enum Gpr { RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7, R12 = 12, R13 = 13, R14 = 14, R15 = 15 };
+
+// xmm15 is scratch for sign masks; the operand stack uses xmm0..xmm14
+constexpr int JIT_MAX_DEPTH = 15;
+constexpr int XMM_SCRATCH = 15;
+
+// frame below the six pushed registers: 32 bytes shadow space, spill slots, the Win64
+// xmm6..xmm15 save area, the temp slots, then per LoadColumn input its distance from out.
+// 6 pushes leave rsp 8 mod 16, so the frame size is 8 mod 16 too.
+constexpr int32_t SPILL_OFFSET = 32;
+constexpr int32_t XMM_SAVE_OFFSET = 160;
+constexpr int32_t TEMP_OFFSET = XMM_SAVE_OFFSET + 10 * 16;
+
+static int32_t frameSize(int slotCount) {
+    int32_t size = TEMP_OFFSET + 8 * slotCount;
+    return size + (16 + 8 - size % 16) % 16;
+}
+
+struct Assembler {
+    std::vector<uint8_t> code;
+    std::vector<std::pair<size_t, double>> constFixups;
+
+    void byte(uint8_t b) { code.push_back(b); }
+    void bytes(std::initializer_list<uint8_t> bs) { code.insert(code.end(), bs); }
+    void imm32(int32_t v) { for (int i = 0; i < 4; ++i) byte((uint8_t)((uint32_t)v >> (8 * i))); }
+    void imm64(uint64_t v) { for (int i = 0; i < 8; ++i) byte((uint8_t)(v >> (8 * i))); }
+
+    void rex(bool w, int reg, int base) {
+        uint8_t r = (uint8_t)((w ? 8 : 0) | (reg >= 8 ? 4 : 0) | (base >= 8 ? 1 : 0));
+        if (r) byte(0x40 | r);
+    }
+    // [base + disp32]
+    void mem(int reg, int base, int32_t disp) {
+        byte((uint8_t)(0x80 | ((reg & 7) << 3) | (base & 7)));
+        if ((base & 7) == RSP) byte(0x24);
+        imm32(disp);
+    }
+
+    // SSE op with optional mandatory prefix (0xF2 / 0x66 / 0)
+    void sseRR(uint8_t prefix, uint8_t op, int dst, int src) {
+        if (prefix) byte(prefix);
+        rex(false, dst, src);
+        bytes({ 0x0F, op, (uint8_t)(0xC0 | ((dst & 7) << 3) | (src & 7)) });
+    }
+    void sseRM(uint8_t prefix, uint8_t op, int reg, int base, int32_t disp) {
+        if (prefix) byte(prefix);
+        rex(false, reg, base);
+        bytes({ 0x0F, op });
+        mem(reg, base, disp);
+    }
+    void loadConst(int reg, double value) {
+        byte(0xF2);
+        rex(false, reg, 0);
+        bytes({ 0x0F, 0x10, (uint8_t)(((reg & 7) << 3) | 5) });
+        constFixups.emplace_back(code.size(), value);
+        imm32(0);
+    }
+
+    void movsd(int dst, int src) { if (dst != src) sseRR(0xF2, 0x10, dst, src); }
+    void movsdLoad(int reg, int base, int32_t disp) { sseRM(0xF2, 0x10, reg, base, disp); }
+    void movsdStore(int base, int32_t disp, int reg) { sseRM(0xF2, 0x11, reg, base, disp); }
+
+    void push(int r) { if (r >= 8) byte(0x41); byte((uint8_t)(0x50 | (r & 7))); }
+    void pop(int r) { if (r >= 8) byte(0x41); byte((uint8_t)(0x58 | (r & 7))); }
+    void movRR(int dst, int src) { rex(true, src, dst); bytes({ 0x89, (uint8_t)(0xC0 | ((src & 7) << 3) | (dst & 7)) }); }
+    void movLoad(int reg, int base, int32_t disp) { rex(true, reg, base); byte(0x8B); mem(reg, base, disp); }
+    void movStore(int base, int32_t disp, int reg) { rex(true, reg, base); byte(0x89); mem(reg, base, disp); }
+    void subRR(int dst, int src) { rex(true, dst, src); bytes({ 0x2B, (uint8_t)(0xC0 | ((dst & 7) << 3) | (src & 7)) }); }
+    // movsd reg, [base + index]
+    void movsdLoadIndexed(int reg, int base, int index) {
+        byte(0xF2);
+        uint8_t r = (uint8_t)((reg >= 8 ? 4 : 0) | (index >= 8 ? 2 : 0) | (base >= 8 ? 1 : 0));
+        if (r) byte(0x40 | r);
+        bytes({ 0x0F, 0x10, (uint8_t)(0x44 | ((reg & 7) << 3)), (uint8_t)(((index & 7) << 3) | (base & 7)), 0x00 });
+    }
+    void addLoad(int reg, int base, int32_t disp) { rex(true, reg, base); byte(0x03); mem(reg, base, disp); }
+    void callAbs(const void* target) {
+        bytes({ 0x48, 0xB8 });
+        imm64((uint64_t)(uintptr_t)target);
+        bytes({ 0xFF, 0xD0 });
+    }
+};
+
+// emits a call to fn with the operand stack's bottom `live` registers preserved in the spill area
+static void emitCall(Assembler& a, const void* fn, int live, int arg0, int arg1, int dst) {
+    for (int i = 0; i < live; ++i) a.movsdStore(RSP, SPILL_OFFSET + 8 * i, i);
+    a.movsd(0, arg0);
+    if (arg1 >= 0) a.movsd(1, arg1);
+    a.callAbs(fn);
+    a.movsd(dst, 0);
+    for (int i = 0; i < live; ++i) a.movsdLoad(i, RSP, SPILL_OFFSET + 8 * i);
+}
+
+static const void* unaryTarget(OpCode op) {
+    switch (op) {
+    case OpCode::Sin: return (const void*)&jitSin;
+    case OpCode::Cos: return (const void*)&jitCos;
+    case OpCode::Tan: return (const void*)&jitTan;
+    case OpCode::Asin: return (const void*)&jitAsin;
+    case OpCode::Acos: return (const void*)&jitAcos;
+    case OpCode::Atan: return (const void*)&jitAtan;
+    case OpCode::Log: return (const void*)&jitLog;
+    case OpCode::Exp: return (const void*)&jitExp;
+    default: return nullptr;
+    }
+}
+
+static bool emitProgram(Assembler& a, const Program& p) {
+#ifdef _WIN32
+    const int argReg = RCX;
+    const bool win64 = true;
+#else
+    const int argReg = RDI;
+    const bool win64 = false;
+#endif
+    const int savedRegs[] = { RBX, RBP, R12, R13, R14, R15 };
+    const int32_t frame = frameSize(p.tempCount + p.columnCount);
+    const int32_t columnOffset = TEMP_OFFSET + 8 * p.tempCount;
+    for (int r : savedRegs) a.push(r);
+    a.bytes({ 0x48, 0x81, 0xEC }); a.imm32(frame);
+    if (win64) for (int x = 6; x < 16; ++x) a.sseRM(0, 0x11, x, RSP, XMM_SAVE_OFFSET + 16 * (x - 6));
+
+    a.movRR(RBP, argReg);
+    a.movLoad(R12, RBP, (int32_t)offsetof(JitArgs, xs));
+    a.movLoad(R13, RBP, (int32_t)offsetof(JitArgs, ys));
+    a.movLoad(RBX, RBP, (int32_t)offsetof(JitArgs, vars));
+    a.movLoad(R14, RBP, (int32_t)offsetof(JitArgs, out));
+    a.movLoad(R15, RBP, (int32_t)offsetof(JitArgs, n));
+    for (int k = 0; k < p.columnCount; ++k) {
+        a.movLoad(RAX, RBP, (int32_t)offsetof(JitArgs, columns));
+        a.movLoad(RAX, RAX, 8 * k);
+        a.subRR(RAX, R14);
+        a.movStore(RSP, columnOffset + 8 * k, RAX);
+    }
+    a.bytes({ 0x4D, 0x85, 0xFF });               // test r15, r15
+    a.bytes({ 0x0F, 0x84 });                     // jz done
+    size_t jzFixup = a.code.size();
+    a.imm32(0);
+    size_t loopStart = a.code.size();
+
+    int d = 0;
+    for (const Instr& in : p.code) {
+        switch (in.op) {
+        case OpCode::Const: a.loadConst(d++, in.value); break;
+        case OpCode::LoadX: a.movsdLoad(d++, R12, 0); break;
+        case OpCode::LoadY: a.movsdLoad(d++, R13, 0); break;
+        case OpCode::LoadVar: a.movsdLoad(d++, RBX, in.slot * 8); break;
+        case OpCode::LoadColumn:
+            a.movLoad(RAX, RSP, columnOffset + 8 * in.slot);
+            a.movsdLoadIndexed(d++, R14, RAX);
+            break;
+        case OpCode::LoadTemp: a.movsdLoad(d++, RSP, TEMP_OFFSET + in.slot * 8); break;
+        case OpCode::StoreTemp: a.movsdStore(RSP, TEMP_OFFSET + in.slot * 8, d - 1); break;
+        case OpCode::Add: a.sseRR(0xF2, 0x58, d - 2, d - 1); --d; break;
+        case OpCode::Mul: a.sseRR(0xF2, 0x59, d - 2, d - 1); --d; break;
+        case OpCode::Sub: a.sseRR(0xF2, 0x5C, d - 2, d - 1); --d; break;
+        case OpCode::Div: a.sseRR(0xF2, 0x5E, d - 2, d - 1); --d; break;
+        case OpCode::Pow: emitCall(a, (const void*)&jitPow, d - 2, d - 2, d - 1, d - 2); --d; break;
+        case OpCode::Sqrt: a.sseRR(0xF2, 0x51, d - 1, d - 1); break;
+        case OpCode::Neg:
+            a.loadConst(XMM_SCRATCH, -0.0);
+            a.sseRR(0x66, 0x57, d - 1, XMM_SCRATCH);   // xorpd
+            break;
+        case OpCode::Abs: {
+            uint64_t bits = 0x7FFFFFFFFFFFFFFFull;
+            double mask; std::memcpy(&mask, &bits, sizeof(mask));
+            a.loadConst(XMM_SCRATCH, mask);
+            a.sseRR(0x66, 0x54, d - 1, XMM_SCRATCH);   // andpd
+            break;
+        }
+        case OpCode::PowI: {
+            // same square-and-multiply chain as powi(), base kept in the scratch register
+            unsigned e = in.slot < 0 ? 0u - (unsigned)in.slot : (unsigned)in.slot;
+            if (e == 0) { a.loadConst(d - 1, 1.0); break; }
+            int bit = 31;
+            while (!((e >> bit) & 1u)) --bit;
+            a.movsd(XMM_SCRATCH, d - 1);
+            while (--bit >= 0) {
+                a.sseRR(0xF2, 0x59, d - 1, d - 1);
+                if ((e >> bit) & 1u) a.sseRR(0xF2, 0x59, d - 1, XMM_SCRATCH);
+            }
+            if (in.slot < 0) {
+                a.loadConst(XMM_SCRATCH, 1.0);
+                a.sseRR(0xF2, 0x5E, XMM_SCRATCH, d - 1);
+                a.movsd(d - 1, XMM_SCRATCH);
+            }
+            break;
+        }
+        default:
+            emitCall(a, unaryTarget(in.op), d - 1, d - 1, -1, d - 1);
+            break;
+        }
+    }
+
+    a.movsdStore(R14, 0, 0);
+    a.addLoad(R12, RBP, (int32_t)offsetof(JitArgs, xStride));
+    a.addLoad(R13, RBP, (int32_t)offsetof(JitArgs, yStride));
+    a.bytes({ 0x49, 0x83, 0xC6, 0x08 });         // add r14, 8
+    a.bytes({ 0x49, 0xFF, 0xCF });               // dec r15
+    a.bytes({ 0x0F, 0x85 });                     // jnz loop
+    a.imm32((int32_t)(loopStart - (a.code.size() + 4)));
+    size_t done = a.code.size();
+    int32_t rel = (int32_t)(done - (jzFixup + 4));
+    std::memcpy(&a.code[jzFixup], &rel, 4);
+
+    if (win64) for (int x = 6; x < 16; ++x) a.sseRM(0, 0x10, x, RSP, XMM_SAVE_OFFSET + 16 * (x - 6));
+    a.bytes({ 0x48, 0x81, 0xC4 }); a.imm32(frame);
+    for (int i = 5; i >= 0; --i) a.pop(savedRegs[i]);
+    a.byte(0xC3);
+
+    // constant pool after the code, addressed rip-relative
+    while (a.code.size() % 8) a.byte(0xCC);
+    for (auto& f : a.constFixups) {
+        size_t at = a.code.size();
+        uint64_t bits; std::memcpy(&bits, &f.second, sizeof(bits));
+        a.imm64(bits);
+        int32_t disp = (int32_t)(at - (f.first + 4));
+        std::memcpy(&a.code[f.first], &disp, 4);
+    }
+    return true;
+}
+
+static void* allocExecutable(const std::vector<uint8_t>& code, size_t& size) {
+    size = code.size();
+#ifdef _WIN32
+    void* mem = VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (!mem) return nullptr;
+    std::memcpy(mem, code.data(), size);
+    DWORD old;
+    if (!VirtualProtect(mem, size, PAGE_EXECUTE_READ, &old)) { VirtualFree(mem, 0, MEM_RELEASE); return nullptr; }
+    FlushInstructionCache(GetCurrentProcess(), mem, size);
+#else
+    void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) return nullptr;
+    std::memcpy(mem, code.data(), size);
+    if (mprotect(mem, size, PROT_READ | PROT_EXEC) != 0) { munmap(mem, size); return nullptr; }
+#endif
+    return mem;
+}
+
+#endif
+
+JitProgram compileJit(const Program& p) {
+    JitProgram jp;
+    jp.program_ = p;
+#ifdef JIT_X64
+    if (p.maxStack > JIT_MAX_DEPTH) return jp;
+    Assembler a;
+    if (!emitProgram(a, p)) return jp;
+    size_t size = 0;
+    void* mem = allocExecutable(a.code, size);
+    if (!mem) return jp;
+    jp.memory_ = mem;
+    jp.size_ = size;
+    jp.fn_ = reinterpret_cast<void (*)(const JitArgs*)>(mem);
+#endif
+    return jp;
+}
+
+bool jitPreferred(const Program& p) {
+#ifdef JIT_X64
+    for (const Instr& in : p.code) {
+        if (in.op == OpCode::Pow) return false;
+        if (in.op >= OpCode::Sin && in.op <= OpCode::Exp && in.op != OpCode::Sqrt) return false;
+    }
+    return p.maxStack <= JIT_MAX_DEPTH;
+#else
+    (void)p;
+    return false;
+#endif
+}
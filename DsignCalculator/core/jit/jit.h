@@ -0,0 +1,53 @@
+#pragma once
+#include "../compiler/compiler.h"
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define JIT_X64 1
+#endif
+
+struct JitArgs {
+    const double* xs;
+    const double* ys;
+    const double* vars;
+    double* out;
+    size_t n;
+    size_t xStride;  // in bytes; 0 broadcasts *xs
+    size_t yStride;
+    const double* const* columns;  // LoadColumn inputs, advanced with out
+};
+
+// Native x86-64 translation of a Program. The operand stack lives in xmm0..xmm14, arithmetic is
+// inline SSE2 and transcendentals call into libm. When the target is not x86-64, or the program is
+// deeper than the register file, the JitProgram keeps a copy of the Program and runs the interpreter.
+class JitProgram {
+public:
+    JitProgram() = default;
+    ~JitProgram();
+    JitProgram(JitProgram&& other) noexcept;
+    JitProgram& operator=(JitProgram&& other) noexcept;
+    JitProgram(const JitProgram&) = delete;
+    JitProgram& operator=(const JitProgram&) = delete;
+
+    bool isNative() const { return fn_ != nullptr; }
+    // same contract as evaluateProgramBatch: returns the number of non-finite results
+    size_t evaluateBatch(const double* xs, const double* ys, const double* vars, double* out, size_t n, uint8_t* invalid = nullptr,
+        const double* const* columns = nullptr) const;
+    // only for programs without LoadColumn inputs
+    double evaluate(double x, double y, const double* vars) const;
+
+private:
+    friend JitProgram compileJit(const Program& p);
+    void release();
+
+    Program program_;
+    void (*fn_)(const JitArgs*) = nullptr;
+    void* memory_ = nullptr;
+    size_t size_ = 0;
+};
+
+JitProgram compileJit(const Program& p);
+
+// true when p is pure arithmetic; with libm calls the vectorized batch interpreter is faster
+bool jitPreferred(const Program& p);
@@ -0,0 +1,118 @@
+#include "equation.h"
+#include "optimizer.h"
+#include "../evaluator/evaluator.h"
+#include <cmath>
+
+// node = a*v + b over graph node indices; -1 stands for a zero term
+struct LinearForm {
+    bool linear = false;
+    int a = -1;
+    int b = -1;
+};
+
+struct Builder {
+    ExprGraph& g;
+
+    int node(OpCode op, int a, int b = -1) {
+        ExprNode n;
+        n.op = op;
+        n.a = a;
+        n.b = b;
+        return g.add(n);
+    }
+    int constant(double v) {
+        ExprNode n;
+        n.value = v;
+        return g.add(n);
+    }
+    int add(int a, int b) { return a < 0 ? b : b < 0 ? a : node(OpCode::Add, a, b); }
+    int neg(int a) { return a < 0 ? -1 : node(OpCode::Neg, a); }
+    int sub(int a, int b) { return b < 0 ? a : a < 0 ? neg(b) : node(OpCode::Sub, a, b); }
+    int mul(int a, int c) { return a < 0 ? -1 : node(OpCode::Mul, a, c); }
+    int div(int a, int c) { return a < 0 ? -1 : node(OpCode::Div, a, c); }
+};
+
+// root of an expression for v (LoadX or LoadY) solving g == 0, or -1 when g is not linear in v;
+// coefficient receives the node of A in g = A*v + B
+static int solveLinear(ExprGraph& g, OpCode v, int& coefficient) {
+    const uint8_t mask = v == OpCode::LoadX ? DEPENDS_X : DEPENDS_Y;
+    std::vector<uint8_t> deps = nodeDependencies(g);
+    const size_t count = g.nodes.size();
+    std::vector<LinearForm> forms(count);
+    Builder b{ g };
+
+    for (size_t i = 0; i < count; ++i) {
+        const ExprNode n = g.nodes[i];
+        LinearForm& f = forms[i];
+        if (!(deps[i] & mask)) { f.linear = true; f.b = (int)i; continue; }
+        const LinearForm fa = n.a >= 0 ? forms[n.a] : LinearForm();
+        const LinearForm fb = n.b >= 0 ? forms[n.b] : LinearForm();
+        switch (n.op) {
+        case OpCode::LoadX:
+        case OpCode::LoadY:
+            f.linear = true;
+            f.a = b.constant(1.0);
+            break;
+        case OpCode::Add:
+            if (fa.linear && fb.linear) f = { true, b.add(fa.a, fb.a), b.add(fa.b, fb.b) };
+            break;
+        case OpCode::Sub:
+            if (fa.linear && fb.linear) f = { true, b.sub(fa.a, fb.a), b.sub(fa.b, fb.b) };
+            break;
+        case OpCode::Neg:
+            if (fa.linear) f = { true, b.neg(fa.a), b.neg(fa.b) };
+            break;
+        case OpCode::Mul:
+            if (!(deps[n.a] & mask) && fb.linear) f = { true, b.mul(fb.a, n.a), b.mul(fb.b, n.a) };
+            else if (!(deps[n.b] & mask) && fa.linear) f = { true, b.mul(fa.a, n.b), b.mul(fa.b, n.b) };
+            break;
+        case OpCode::Div:
+            if (!(deps[n.b] & mask) && fa.linear) f = { true, b.div(fa.a, n.b), b.div(fa.b, n.b) };
+            break;
+        default:
+            break;
+        }
+    }
+
+    const LinearForm& root = forms[g.root];
+    if (!root.linear || root.a < 0) return -1;
+    coefficient = root.a;
+    int rhs = root.b < 0 ? b.constant(0.0) : b.neg(root.b);
+    return b.node(OpCode::Div, rhs, root.a);
+}
+
+// true when A, the coefficient of the solved variable, is free of x and y and non-zero for env:
+// v = -B / A is then the whole curve. An A that reads the other coordinate vanishes somewhere
+// (x*y = 0 is also the line x = 0), and one that folds to 0 (y*0 = x) leaves B = 0 to plot.
+static bool coefficientNonZero(const ExprGraph& g, int coefficient, const std::unordered_map<std::string, double>* env) {
+    ExprGraph a = g;
+    a.root = coefficient;
+    optimizeExprGraph(a, env);
+    if (nodeDependencies(a)[a.root] & (DEPENDS_X | DEPENDS_Y)) return false;
+    Program lowered = lowerExprGraph(a);
+    std::vector<double> vars = bindVariables(lowered, env);
+    double value = evaluateProgram(lowered, 0.0, 0.0, vars.data());
+    return std::isfinite(value) && value != 0.0;
+}
+
+SolvedEquation solveEquation(const Program& p, const std::unordered_map<std::string, double>* env) {
+    SolvedEquation s;
+    const OpCode order[] = { OpCode::LoadY, OpCode::LoadX };
+    for (OpCode v : order) {
+        ExprGraph g = buildExprGraph(p);
+        int coefficient = -1;
+        int root = solveLinear(g, v, coefficient);
+        if (root < 0 || !coefficientNonZero(g, coefficient, env)) continue;
+        g.root = root;
+        optimizeExprGraph(g);
+        s.function = lowerExprGraph(g);
+        if (v == OpCode::LoadX) {
+            for (Instr& in : s.function.code) if (in.op == OpCode::LoadY) in.op = OpCode::LoadX;
+            s.function.usesX = s.function.usesY;
+            s.function.usesY = false;
+        }
+        s.form = v == OpCode::LoadY ? EquationForm::ExplicitY : EquationForm::ExplicitX;
+        return s;
+    }
+    return s;
+}
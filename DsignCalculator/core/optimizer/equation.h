@@ -0,0 +1,23 @@
+#pragma once
+#include "expr_graph.h"
+#include <string>
+#include <unordered_map>
+
+// how an equation F(x, y) = 0 is best plotted
+enum class EquationForm {
+    Implicit,   // needs the 2D grid
+    ExplicitY,  // y = f(x)
+    ExplicitX   // x = f(y)
+};
+
+struct SolvedEquation {
+    EquationForm form = EquationForm::Implicit;
+    // ExplicitY: f(x). ExplicitX: f(y), with y read through LoadX so the 1D sampler can run it.
+    Program function;
+};
+
+// Isolates y, or failing that x, when F is linear in it: F = A*v + B with A and B free of v
+// gives v = -B / A, as long as A is free of the other coordinate too and non-zero with the
+// parameters bound from env (missing names read as 0). Relations such as x^2+y^2-25, x*y = 0 or
+// y*0 = x stay Implicit or fall through to the other variable.
+SolvedEquation solveEquation(const Program& p, const std::unordered_map<std::string, double>* env = nullptr);
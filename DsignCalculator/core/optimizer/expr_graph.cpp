@@ -0,0 +1,95 @@
+#include "expr_graph.h"
+#include <algorithm>
+#include <stdexcept>
+
+ExprGraph buildExprGraph(const Program& p) {
+    ExprGraph g;
+    g.variables = p.variables;
+    g.nodes.reserve(p.code.size());
+    std::vector<int> stack;
+    stack.reserve(p.maxStack);
+    std::vector<int> temps(p.tempCount, -1);
+
+    for (const Instr& in : p.code) {
+        if (in.op == OpCode::StoreTemp) { temps[in.slot] = stack.back(); continue; }
+        if (in.op == OpCode::LoadTemp) { stack.push_back(temps[in.slot]); continue; }
+        ExprNode n;
+        n.op = in.op;
+        n.value = in.value;
+        n.slot = in.slot;
+        int arity = opArity(in.op);
+        if (arity == 2) { n.b = stack.back(); stack.pop_back(); }
+        if (arity >= 1) { n.a = stack.back(); stack.pop_back(); }
+        stack.push_back(g.add(n));
+    }
+    g.root = stack.empty() ? -1 : stack.back();
+    return g;
+}
+
+std::vector<uint8_t> nodeDependencies(const ExprGraph& g) {
+    std::vector<uint8_t> deps(g.nodes.size(), 0);
+    for (size_t i = 0; i < g.nodes.size(); ++i) {
+        const ExprNode& n = g.nodes[i];
+        if (n.op == OpCode::LoadX || n.op == OpCode::LoadColumn) deps[i] = DEPENDS_X;
+        if (n.op == OpCode::LoadY) deps[i] = DEPENDS_Y;
+        if (n.a >= 0) deps[i] |= deps[n.a];
+        if (n.b >= 0) deps[i] |= deps[n.b];
+    }
+    return deps;
+}
+
+static bool isLoad(OpCode op) { return op <= OpCode::LoadColumn; }
+
+struct Lowering {
+    const ExprGraph& g;
+    Program& p;
+    std::vector<int> uses;
+    std::vector<int> temp;     // temp slot of an already emitted shared node, -1 otherwise
+
+    // returns the stack depth needed to evaluate node i
+    int emit(int i) {
+        if (temp[i] >= 0) {
+            p.code.push_back({ OpCode::LoadTemp, temp[i] });
+            return 1;
+        }
+        const ExprNode& n = g.nodes[i];
+        int depth = 1;
+        if (n.a >= 0) depth = std::max(depth, emit(n.a));
+        if (n.b >= 0) depth = std::max(depth, emit(n.b) + 1);
+
+        Instr in;
+        in.op = n.op;
+        in.value = n.value;
+        in.slot = n.slot;
+        if (n.op == OpCode::LoadX) p.usesX = true;
+        if (n.op == OpCode::LoadY) p.usesY = true;
+        if (n.op == OpCode::LoadColumn) p.columnCount = std::max(p.columnCount, n.slot + 1);
+        p.code.push_back(in);
+
+        if (uses[i] > 1 && !isLoad(n.op) && p.tempCount < PROGRAM_MAX_TEMPS) {
+            temp[i] = p.tempCount++;
+            p.code.push_back({ OpCode::StoreTemp, temp[i] });
+        }
+        return depth;
+    }
+};
+
+Program lowerExprGraph(const ExprGraph& g) {
+    Program p;
+    p.variables = g.variables;
+    if (g.root < 0) throw std::runtime_error("Invalid evaluation");
+
+    Lowering l{ g, p, std::vector<int>(g.nodes.size(), 0), std::vector<int>(g.nodes.size(), -1) };
+    std::vector<char> reached(g.nodes.size(), 0);
+    reached[g.root] = 1;
+    for (int i = g.root; i >= 0; --i) {
+        if (!reached[i]) continue;
+        const ExprNode& n = g.nodes[i];
+        if (n.a >= 0) { ++l.uses[n.a]; reached[n.a] = 1; }
+        if (n.b >= 0) { ++l.uses[n.b]; reached[n.b] = 1; }
+    }
+
+    p.maxStack = l.emit(g.root);
+    if (p.maxStack > PROGRAM_MAX_STACK) throw std::runtime_error("Expression too deep");
+    return p;
+}
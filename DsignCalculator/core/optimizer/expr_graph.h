@@ -0,0 +1,67 @@
+#pragma once
+#include "../compiler/compiler.h"
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct ExprNode {
+    OpCode op = OpCode::Const;
+    int a = -1;          // operand node indices, -1 when unused
+    int b = -1;
+    double value = 0.0;  // Const
+    int32_t slot = 0;    // LoadVar slot, LoadColumn index, PowI exponent
+};
+
+struct ExprNodeHash {
+    size_t operator()(const ExprNode& n) const {
+        uint64_t bits;
+        std::memcpy(&bits, &n.value, sizeof bits);
+        uint64_t h = (uint64_t)n.op;
+        h = h * 0x9E3779B97F4A7C15ull ^ (uint32_t)n.a;
+        h = h * 0x9E3779B97F4A7C15ull ^ (uint32_t)n.b;
+        h = h * 0x9E3779B97F4A7C15ull ^ (uint32_t)n.slot;
+        h = h * 0x9E3779B97F4A7C15ull ^ bits;
+        return (size_t)(h ^ (h >> 29));
+    }
+};
+
+struct ExprNodeEqual {
+    bool operator()(const ExprNode& l, const ExprNode& r) const {
+        return l.op == r.op && l.a == r.a && l.b == r.b && l.slot == r.slot &&
+            std::memcmp(&l.value, &r.value, sizeof l.value) == 0;
+    }
+};
+
+// Hash-consed expression DAG over node indices. Operands always precede their users in `nodes`,
+// and add() returns the existing index for a structurally equal node, so repeated subexpressions
+// share one node. Operands of + and * are put in index order so a+b and b+a meet as well.
+struct ExprGraph {
+    std::vector<ExprNode> nodes;
+    std::vector<std::string> variables;
+    int root = -1;
+
+    int add(ExprNode n) {
+        if ((n.op == OpCode::Add || n.op == OpCode::Mul) && n.b < n.a) std::swap(n.a, n.b);
+        auto it = interned_.find(n);
+        if (it != interned_.end()) return it->second;
+        nodes.push_back(n);
+        interned_.emplace(n, (int)nodes.size() - 1);
+        return (int)nodes.size() - 1;
+    }
+
+private:
+    std::unordered_map<ExprNode, int, ExprNodeHash, ExprNodeEqual> interned_;
+};
+
+ExprGraph buildExprGraph(const Program& p);
+
+constexpr uint8_t DEPENDS_X = 1;
+constexpr uint8_t DEPENDS_Y = 2;
+
+// bit mask of the sample coordinates each node reads, directly or through its operands
+// (LoadColumn inputs count as x)
+std::vector<uint8_t> nodeDependencies(const ExprGraph& g);
+// Emits the nodes reachable from root; non-trivial nodes with several users are computed once
+// into a temp slot and reloaded afterwards.
+Program lowerExprGraph(const ExprGraph& g);
@@ -0,0 +1,85 @@
+#include "hoisting.h"
+#include "../evaluator/evaluator.h"
+#include <string>
+
+// Lowers every maximal subexpression depending on exactly `mask` into parts and replaces it in
+// the returned graph by the node makeLoad(index into parts). A subexpression is maximal when a
+// node of another class (or the result) consumes it; loads and constants are left in place.
+template <class MakeLoad>
+static ExprGraph extractSubexpressions(const ExprGraph& g, uint8_t mask, std::vector<Program>& parts, MakeLoad makeLoad) {
+    std::vector<uint8_t> deps = nodeDependencies(g);
+    std::vector<char> extract(g.nodes.size(), 0);
+    auto consider = [&](int i) {
+        if (i >= 0 && deps[i] == mask && g.nodes[i].op > OpCode::LoadColumn) extract[i] = 1;
+    };
+    for (size_t i = 0; i < g.nodes.size(); ++i) {
+        if (deps[i] == mask) continue;
+        consider(g.nodes[i].a);
+        consider(g.nodes[i].b);
+    }
+    consider(g.root);
+
+    ExprGraph out;
+    out.variables = g.variables;
+    std::vector<int> remap(g.nodes.size(), -1);
+    for (size_t i = 0; i < g.nodes.size(); ++i) {
+        ExprNode n = g.nodes[i];
+        if (extract[i]) {
+            ExprGraph sub = g;
+            sub.root = (int)i;
+            parts.push_back(lowerExprGraph(sub));
+            n = makeLoad(out, (int)parts.size() - 1);
+        }
+        else {
+            if (n.a >= 0) n.a = remap[n.a];
+            if (n.b >= 0) n.b = remap[n.b];
+        }
+        remap[i] = out.add(n);
+    }
+    out.root = remap[g.root];
+    return out;
+}
+
+// LoadVar of a new frame slot appended to g.variables under name
+static ExprNode addFrameSlot(ExprGraph& g, const std::string& name) {
+    ExprNode n;
+    n.op = OpCode::LoadVar;
+    n.slot = (int32_t)g.variables.size();
+    g.variables.push_back(name);
+    return n;
+}
+
+HoistedProgram hoistInvariants(const Program& p) {
+    HoistedProgram h;
+    ExprGraph g = buildExprGraph(p);
+    h.firstInvariant = (int)g.variables.size();
+    ExprGraph body = extractSubexpressions(g, 0, h.invariants, [](ExprGraph& out, int k) {
+        return addFrameSlot(out, "#" + std::to_string(k));
+    });
+    h.body = lowerExprGraph(body);
+    return h;
+}
+
+void evaluateInvariants(const HoistedProgram& h, std::vector<double>& frame) {
+    frame.resize(h.firstInvariant + h.invariants.size(), 0.0);
+    for (size_t i = 0; i < h.invariants.size(); ++i) {
+        frame[h.firstInvariant + i] = evaluateProgram(h.invariants[i], 0.0, 0.0, frame.data());
+    }
+}
+
+GridProgram separateGrid(const Program& p) {
+    GridProgram s;
+    ExprGraph g = buildExprGraph(p);
+    g = extractSubexpressions(g, DEPENDS_X, s.columns, [](ExprGraph&, int k) {
+        ExprNode n;
+        n.op = OpCode::LoadColumn;
+        n.slot = k;
+        return n;
+    });
+    s.firstRow = (int)g.variables.size();
+    g = extractSubexpressions(g, DEPENDS_Y, s.rows, [](ExprGraph& out, int k) {
+        return addFrameSlot(out, "#y" + std::to_string(k));
+    });
+    s.body = lowerExprGraph(g);
+    return s;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "expr_graph.h"
+#include <vector>
+
+// p split into an invariant prologue and a per-sample body. Subexpressions that read neither x
+// nor y are lowered to invariants[i], and the body reads their values back from LoadVar slot
+// firstInvariant + i. Those slots are named "#i", which no tokenized identifier can clash with.
+struct HoistedProgram {
+    Program body;
+    std::vector<Program> invariants;
+    int firstInvariant = 0;
+};
+
+HoistedProgram hoistInvariants(const Program& p);
+
+// Fills the invariant slots of a frame built with bindVariables(h.body, env). Run once per
+// parameter change; the invariant programs only read the parameter slots before firstInvariant.
+void evaluateInvariants(const HoistedProgram& h, std::vector<double>& frame);
+
+// p split for evaluation over a grid of x columns and y rows. Subexpressions of x alone become
+// columns[k], evaluated once per grid column and read by the body through LoadColumn k;
+// subexpressions of y alone become rows[k], evaluated once per grid row into frame slot
+// firstRow + k ("#yk"). Separable curves such as x^2+y^2=25 then cost O(nx + ny) calls to the
+// expensive parts instead of O(nx * ny).
+struct GridProgram {
+    Program body;
+    std::vector<Program> columns;
+    std::vector<Program> rows;
+    int firstRow = 0;
+};
+
+GridProgram separateGrid(const Program& p);
@@ -0,0 +1,134 @@
+#include "optimizer.h"
+#include "../evaluator/evaluator.h"
+#include <cmath>
+
+// larger integer exponents keep going through std::pow
+constexpr int MAX_POWI_EXPONENT = 64;
+
+static bool isConst(const ExprGraph& g, int i) { return g.nodes[i].op == OpCode::Const; }
+static bool isConst(const ExprGraph& g, int i, double v) { return isConst(g, i) && g.nodes[i].value == v; }
+
+static int addConst(ExprGraph& g, double v) {
+    ExprNode n;
+    n.op = OpCode::Const;
+    n.value = v;
+    return g.add(n);
+}
+
+static ExprNode makeNode(OpCode op, int a, int b = -1, int32_t slot = 0) {
+    ExprNode n;
+    n.op = op;
+    n.a = a;
+    n.b = b;
+    n.slot = slot;
+    return n;
+}
+
+static int simplify(ExprGraph& g, ExprNode n, const std::unordered_map<std::string, double>* env);
+
+// c1 op (a op c2) / (a op c2) op c1 -> a op (c1 op c2) for associative +, *
+static int reassociate(ExprGraph& g, OpCode op, int constSide, int other, const std::unordered_map<std::string, double>* env) {
+    const ExprNode& inner = g.nodes[other];
+    if (inner.op != op) return -1;
+    int innerConst = isConst(g, inner.b) ? inner.b : (isConst(g, inner.a) ? inner.a : -1);
+    if (innerConst < 0) return -1;
+    int rest = innerConst == inner.b ? inner.a : inner.b;
+    double c = evaluateOp(op, g.nodes[constSide].value, g.nodes[innerConst].value, 0);
+    return simplify(g, makeNode(op, rest, addConst(g, c)), env);
+}
+
+static int simplify(ExprGraph& g, ExprNode n, const std::unordered_map<std::string, double>* env) {
+    if (n.op == OpCode::LoadVar && env) {
+        auto it = env->find(g.variables[n.slot]);
+        if (it != env->end()) return addConst(g, it->second);
+    }
+
+    int arity = opArity(n.op);
+    if (arity > 0 && isConst(g, n.a) && (arity == 1 || isConst(g, n.b)))
+        return addConst(g, evaluateOp(n.op, g.nodes[n.a].value, arity == 2 ? g.nodes[n.b].value : 0.0, n.slot));
+
+    switch (n.op) {
+    case OpCode::Add:
+        if (isConst(g, n.b, 0.0)) return n.a;
+        if (isConst(g, n.a, 0.0)) return n.b;
+        if (isConst(g, n.b)) { int r = reassociate(g, n.op, n.b, n.a, env); if (r >= 0) return r; }
+        if (isConst(g, n.a)) { int r = reassociate(g, n.op, n.a, n.b, env); if (r >= 0) return r; }
+        break;
+
+    case OpCode::Sub:
+        if (isConst(g, n.b, 0.0)) return n.a;
+        if (isConst(g, n.a, 0.0)) return simplify(g, makeNode(OpCode::Neg, n.b), env);
+        break;
+
+    case OpCode::Mul:
+        if (isConst(g, n.b, 1.0)) return n.a;
+        if (isConst(g, n.a, 1.0)) return n.b;
+        if (isConst(g, n.b)) { int r = reassociate(g, n.op, n.b, n.a, env); if (r >= 0) return r; }
+        if (isConst(g, n.a)) { int r = reassociate(g, n.op, n.a, n.b, env); if (r >= 0) return r; }
+        break;
+
+    case OpCode::Div:
+        if (isConst(g, n.b)) {
+            double c = g.nodes[n.b].value;
+            double inv = 1.0 / c;
+            if (std::isnormal(c) && std::isnormal(inv)) {
+                return simplify(g, makeNode(OpCode::Mul, n.a, addConst(g, inv)), env);
+            }
+        }
+        break;
+
+    case OpCode::Pow:
+        if (isConst(g, n.a, 2.71828182845904523536)) return simplify(g, makeNode(OpCode::Exp, n.b), env);
+        if (isConst(g, n.b)) {
+            double c = g.nodes[n.b].value;
+            if (c == std::floor(c) && std::fabs(c) <= MAX_POWI_EXPONENT) {
+                if (c == 0.0) return addConst(g, 1.0);
+                if (c == 1.0) return n.a;
+                return simplify(g, makeNode(OpCode::PowI, n.a, -1, (int32_t)c), env);
+            }
+        }
+        break;
+
+    case OpCode::Neg:
+        if (g.nodes[n.a].op == OpCode::Neg) return g.nodes[n.a].a;
+        break;
+
+    case OpCode::Abs:
+        if (g.nodes[n.a].op == OpCode::Abs) return n.a;
+        if (g.nodes[n.a].op == OpCode::Neg) return simplify(g, makeNode(OpCode::Abs, g.nodes[n.a].a), env);
+        break;
+
+    case OpCode::PowI:
+        if (g.nodes[n.a].op == OpCode::Neg && n.slot % 2 == 0) {
+            return g.add(makeNode(OpCode::PowI, g.nodes[n.a].a, -1, n.slot));
+        }
+        break;
+
+    default:
+        break;
+    }
+    return g.add(n);
+}
+
+void optimizeExprGraph(ExprGraph& g, const std::unordered_map<std::string, double>* env) {
+    if (g.root < 0) return;
+    ExprGraph out;
+    out.variables = g.variables;
+    out.nodes.reserve(g.nodes.size());
+    std::vector<int> remap(g.nodes.size(), -1);
+
+    for (size_t i = 0; i < g.nodes.size(); ++i) {
+        ExprNode n = g.nodes[i];
+        if (n.a >= 0) n.a = remap[n.a];
+        if (n.b >= 0) n.b = remap[n.b];
+        remap[i] = simplify(out, n, env);
+    }
+    out.root = remap[g.root];
+    g = std::move(out);
+}
+
+Program optimizeProgram(const Program& p, const std::unordered_map<std::string, double>* env) {
+    ExprGraph g = buildExprGraph(p);
+    optimizeExprGraph(g, env);
+    return lowerExprGraph(g);
+}
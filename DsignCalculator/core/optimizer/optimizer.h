@@ -0,0 +1,11 @@
+#pragma once
+#include "expr_graph.h"
+#include <string>
+#include <unordered_map>
+
+// Rewrites g bottom-up: folds constant subtrees (variables bound in env count as constants),
+// turns small integer powers into multiply chains and division by a constant into multiplication
+// by its reciprocal, e^a into exp(a), and drops identities such as *1, +0 and neg(neg(a)).
+void optimizeExprGraph(ExprGraph& g, const std::unordered_map<std::string, double>* env = nullptr);
+
+Program optimizeProgram(const Program& p, const std::unordered_map<std::string, double>* env = nullptr);
@@ -0,0 +1,16 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+
+// Polled by long computations between chunks of work. A cancelled computation is abandoned, an
+// expired one finishes what it has started and returns a coarser but still valid result.
+struct StopToken {
+    const std::atomic<bool>* cancel = nullptr;
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+
+    bool cancelled() const { return cancel && cancel->load(std::memory_order_relaxed); }
+    bool expired() const {
+        return deadline != std::chrono::steady_clock::time_point::max() && std::chrono::steady_clock::now() >= deadline;
+    }
+    bool stopRequested() const { return cancelled() || expired(); }
+};
@@ -0,0 +1,111 @@
+#include "thread_pool.h"
+
+// the pool and queue index of the current thread when it is a worker
+static thread_local ThreadPool* current_pool = nullptr;
+static thread_local size_t current_queue = 0;
+
+ThreadPool::ThreadPool(size_t threads) {
+    size_t workers = threads > 1 ? threads - 1 : 0;
+    for (size_t i = 0; i < workers; ++i) queues_.push_back(std::make_unique<Queue>());
+    for (size_t i = 0; i < workers; ++i) workers_.emplace_back([this, i]() { workerLoop(i); });
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& w : workers_) w.join();
+}
+
+void ThreadPool::push(Task task) {
+    size_t index = current_pool == this ? current_queue : nextQueue_.fetch_add(1) % queues_.size();
+    {
+        std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+        queues_[index]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        queued_.fetch_add(1);
+    }
+    wake_.notify_one();
+}
+
+// pops the newest task of the own queue, or steals the oldest of another one
+bool ThreadPool::runOne() {
+    size_t own = current_pool == this ? current_queue : 0;
+    Task task;
+    bool found = false;
+    for (size_t k = 0; k < queues_.size() && !found; ++k) {
+        Queue& q = *queues_[(own + k) % queues_.size()];
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.tasks.empty()) continue;
+        if (k == 0 && current_pool == this) { task = std::move(q.tasks.back()); q.tasks.pop_back(); }
+        else { task = std::move(q.tasks.front()); q.tasks.pop_front(); }
+        found = true;
+    }
+    if (!found) return false;
+    queued_.fetch_sub(1);
+
+    std::exception_ptr error;
+    try { task.fn(); }
+    catch (...) { error = std::current_exception(); }
+    task.group->finish(error);
+    return true;
+}
+
+void ThreadPool::workerLoop(size_t index) {
+    current_pool = this;
+    current_queue = index;
+    for (;;) {
+        if (runOne()) continue;
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        wake_.wait(lock, [&]() { return stopping_ || queued_.load() > 0; });
+        if (stopping_ && queued_.load() == 0) return;
+    }
+}
+
+void ThreadPool::notifyAll() {
+    { std::lock_guard<std::mutex> lock(sleepMutex_); }
+    wake_.notify_all();
+}
+
+TaskGroup::~TaskGroup() {
+    try { wait(); }
+    catch (...) {}
+}
+
+void TaskGroup::run(std::function<void()> task) {
+    if (!pool_) {
+        try { task(); }
+        catch (...) { finish(std::current_exception()); }
+        return;
+    }
+    pending_.fetch_add(1);
+    pool_->push({ std::move(task), this });
+}
+
+void TaskGroup::finish(std::exception_ptr error) {
+    if (error) {
+        std::lock_guard<std::mutex> lock(errorMutex_);
+        if (!error_) error_ = error;
+    }
+    // the waiter may destroy the group as soon as pending_ reaches zero
+    ThreadPool* pool = pool_;
+    if (pool && pending_.fetch_sub(1) == 1) pool->notifyAll();
+}
+
+void TaskGroup::wait() {
+    while (pending_.load() > 0) {
+        if (pool_->runOne()) continue;
+        std::unique_lock<std::mutex> lock(pool_->sleepMutex_);
+        pool_->wake_.wait(lock, [&]() { return pending_.load() == 0 || pool_->queued_.load() > 0; });
+    }
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(errorMutex_);
+        std::swap(error, error_);
+    }
+    if (error) std::rethrow_exception(error);
+}
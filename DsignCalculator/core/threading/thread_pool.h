@@ -0,0 +1,74 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaskGroup;
+
+// Work-stealing pool. Every worker owns a deque: it pushes and pops its own tasks at the back and
+// steals from the front of the others' when it runs dry. A thread waiting on a TaskGroup runs
+// queued tasks too, so groups may be nested inside tasks without starving the pool.
+class ThreadPool {
+public:
+    // threads counts the thread that waits on a TaskGroup, so ThreadPool(1) starts no workers
+    explicit ThreadPool(size_t threads = std::thread::hardware_concurrency());
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t threadCount() const { return workers_.size() + 1; }
+
+private:
+    friend class TaskGroup;
+
+    struct Task {
+        std::function<void()> fn;
+        TaskGroup* group = nullptr;
+    };
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void push(Task task);
+    bool runOne();
+    void workerLoop(size_t index);
+    void notifyAll();
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+    std::mutex sleepMutex_;
+    std::condition_variable wake_;
+    std::atomic<size_t> queued_{ 0 };
+    std::atomic<size_t> nextQueue_{ 0 };
+    bool stopping_ = false;
+};
+
+// A batch of tasks that can be waited for as a whole. Without a pool, or on a single-threaded
+// one, run() executes the task immediately. The first exception a task throws is rethrown by wait().
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool* pool) : pool_(pool && !pool->workers_.empty() ? pool : nullptr) {}
+    ~TaskGroup();
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    void run(std::function<void()> task);
+    void wait();
+
+private:
+    friend class ThreadPool;
+    void finish(std::exception_ptr error);
+
+    ThreadPool* pool_;
+    std::atomic<size_t> pending_{ 0 };
+    std::mutex errorMutex_;
+    std::exception_ptr error_;
+};
@@ -0,0 +1,43 @@
+#pragma once
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+// Minimal self-registering checks: TEST(name) { CHECK(...); } in any file of the target, run in
+// registration order by test_main.cpp. A failed CHECK reports and lets the test carry on.
+struct TestCase {
+    const char* name;
+    void (*fn)();
+};
+
+std::vector<TestCase>& testRegistry();
+int& checkFailures();
+
+struct TestRegistrar {
+    TestRegistrar(const char* name, void (*fn)()) { testRegistry().push_back({ name, fn }); }
+};
+
+#define TEST(name) \
+    static void name(); \
+    static TestRegistrar name##Registrar(#name, name); \
+    static void name()
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            std::printf("  %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            ++checkFailures(); \
+        } \
+    } while (0)
+
+// |a - b| <= tol * max(1, |a|, |b|), with NaN matching NaN and infinities matching exactly
+#define CHECK_CLOSE(a, b, tol) \
+    do { \
+        double ca_ = (a), cb_ = (b); \
+        bool same_ = (std::isnan(ca_) && std::isnan(cb_)) || ca_ == cb_ || \
+            std::fabs(ca_ - cb_) <= (tol) * std::fmax(1.0, std::fmax(std::fabs(ca_), std::fabs(cb_))); \
+        if (!same_) { \
+            std::printf("  %s:%d: CHECK_CLOSE(%s, %s) failed: %.17g vs %.17g\n", __FILE__, __LINE__, #a, #b, ca_, cb_); \
+            ++checkFailures(); \
+        } \
+    } while (0)
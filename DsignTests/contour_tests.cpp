@@ -0,0 +1,62 @@
+#include "check.h"
+#include "../DsignCalculator/core/evaluator/evaluator.h"
+#include "../DsignCalculator/core/grapher/contour.h"
+#include "../DsignCalculator/core/optimizer/optimizer.h"
+#include "../DsignCalculator/core/parser/core_parser.h"
+#include "../DsignCalculator/core/tokenizer/tokenizer.h"
+
+// Saddle cells, and marching squares agreeing with ContourTracer on the same lattice.
+
+TEST(marchingSquaresSplitsSaddles) {
+    // TL and BR inside: two segments, which cut off TR and BL when the centre is inside
+    const double inside[4] = { 1.0, -1.0, -1.0, 1.0 };  // rows: TL TR, BL BR
+    std::vector<sf::Vector2f> edges;
+    std::vector<uint32_t> ids;
+    marchingSquares(inside, 2, 2, 2, 1, 0.0, 0.0, 1.0, 1.0, 0, 1, edges, ids);
+    CHECK(edges.size() == 4);
+    for (size_t k = 0; k + 1 < edges.size(); k += 2) {
+        // both ends of a segment lie next to the same outside corner
+        sf::Vector2f mid = (edges[k] + edges[k + 1]) * 0.5f;
+        bool nearTR = mid.x > 0.5f && mid.y < 0.5f, nearBL = mid.x < 0.5f && mid.y > 0.5f;
+        CHECK(nearTR || nearBL);
+    }
+
+    // and TL and BR when it is not
+    const double outside[4] = { 1.0, -3.0, -3.0, 1.0 };
+    edges.clear();
+    ids.clear();
+    marchingSquares(outside, 2, 2, 2, 1, 0.0, 0.0, 1.0, 1.0, 0, 1, edges, ids);
+    CHECK(edges.size() == 4);
+    for (size_t k = 0; k + 1 < edges.size(); k += 2) {
+        sf::Vector2f mid = (edges[k] + edges[k + 1]) * 0.5f;
+        bool nearTL = mid.x < 0.5f && mid.y < 0.5f, nearBR = mid.x > 0.5f && mid.y > 0.5f;
+        CHECK(nearTL || nearBR);
+    }
+}
+
+TEST(marchingSquaresMatchesTracer) {
+    // seeded from every row and column, the tracer finds every curve the grid does, with the same points
+    const char* relations[] = { "sin(x*y)-0.3", "sin(x)+sin(y)", "x*y" };
+    const int nx = 300, ny = 300;
+    const int64_t ix0 = -150, iy0 = -150;
+    const double dx = 40.0 / 299, dy = 26.0 / 299;
+    for (const char* r : relations) {
+        Program p = optimizeProgram(compileRPN(shuntingYard(tokenize(r))));
+        std::vector<double> values((size_t)nx * ny);
+        for (int j = 0; j < ny; ++j) {
+            for (int i = 0; i < nx; ++i) values[(size_t)j * nx + i] = evaluateProgram(p, (ix0 + i) * dx, (iy0 + j) * dy, nullptr);
+        }
+        std::vector<sf::Vector2f> edges;
+        std::vector<uint32_t> ids;
+        marchingSquares(values.data(), nx, ny, nx, 1, ix0 * dx, iy0 * dy, dx, dy, 0, ny - 1, edges, ids);
+        auto grid = stitchSegments(edges, ids, (size_t)nx * ny * 2);
+
+        ContourTracer tracer(p, {}, ix0, iy0, dx, dy, nx, ny);
+        auto traced = tracer.trace(1);
+        size_t gridPoints = 0, tracedPoints = 0;
+        for (const auto& line : grid) gridPoints += line.size();
+        for (const auto& line : traced) tracedPoints += line.size();
+        CHECK(grid.size() == traced.size());
+        CHECK(gridPoints == tracedPoints);
+    }
+}
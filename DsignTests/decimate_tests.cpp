@@ -0,0 +1,66 @@
+#include "check.h"
+#include "../DsignCalculator/core/grapher/grapher.h"
+#include <algorithm>
+#include <map>
+
+// decimateColumns on a strip far denser than the pixels: sin(400 x) at 50 px per unit, sampled
+// every 0.05 px along the axis the columns are taken on.
+
+struct ColumnSpan {
+    float first, last, lo, hi;
+    int count;
+};
+
+static std::map<int, ColumnSpan> columnSpans(const std::vector<sf::Vertex>& strip, bool byRow) {
+    std::map<int, ColumnSpan> spans;
+    for (const sf::Vertex& v : strip) {
+        int column = (int)std::floor(byRow ? v.position.y : v.position.x);
+        float value = byRow ? v.position.x : v.position.y;
+        auto it = spans.find(column);
+        if (it == spans.end()) {
+            spans[column] = { value, value, value, value, 1 };
+            continue;
+        }
+        ColumnSpan& s = it->second;
+        s.last = value;
+        s.lo = std::min(s.lo, value);
+        s.hi = std::max(s.hi, value);
+        ++s.count;
+    }
+    return spans;
+}
+
+static void checkDecimation(bool byRow) {
+    const float step = 0.05f, width = 200.0f, scale = 50.0f;
+    std::vector<sf::Vertex> strip;
+    for (int i = 0; i * step < width; ++i) {
+        float along = 10.0f + i * step;
+        float across = 300.0f - scale * (float)std::sin(400.0 * along / scale);
+        strip.emplace_back(byRow ? sf::Vector2f(across, along) : sf::Vector2f(along, across), sf::Color::Cyan);
+    }
+    std::vector<sf::Vertex> decimated = strip;
+    decimateColumns(decimated, byRow);
+
+    auto full = columnSpans(strip, byRow), kept = columnSpans(decimated, byRow);
+    CHECK(decimated.size() <= 4 * (size_t)width + 4);
+    CHECK(full.size() == kept.size());
+    for (const auto& [column, s] : full) {
+        auto it = kept.find(column);
+        CHECK(it != kept.end());
+        if (it == kept.end()) continue;
+        const ColumnSpan& k = it->second;
+        CHECK(k.count <= 4);
+        CHECK(k.first == s.first);
+        CHECK(k.last == s.last);
+        CHECK(k.lo == s.lo);
+        CHECK(k.hi == s.hi);
+    }
+}
+
+TEST(decimateColumnsKeepsEachPixelColumn) {
+    checkDecimation(false);
+}
+
+TEST(decimateColumnsKeepsEachPixelRow) {
+    checkDecimation(true);
+}
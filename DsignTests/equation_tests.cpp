@@ -0,0 +1,86 @@
+#include "check.h"
+#include "../DsignCalculator/core/evaluator/evaluator.h"
+#include "../DsignCalculator/core/grapher/grapher.h"
+#include "../DsignCalculator/core/optimizer/equation.h"
+#include "../DsignCalculator/core/optimizer/optimizer.h"
+#include "../DsignCalculator/core/parser/core_parser.h"
+#include "../DsignCalculator/core/tokenizer/tokenizer.h"
+#include <string>
+#include <unordered_map>
+
+// solveEquation on lhs = rhs, entered as (lhs)-(rhs) the way the app rewrites it, and what the
+// grapher draws for it on an 800 x 600 screen at 50 px per unit, origin in the middle.
+
+using Env = std::unordered_map<std::string, double>;
+
+static std::vector<Token> equationRPN(const char* lhs, const char* rhs) {
+    return shuntingYard(tokenize(std::string("(") + lhs + ")-(" + rhs + ")"));
+}
+
+static SolvedEquation solve(const char* lhs, const char* rhs, const Env* env = nullptr) {
+    return solveEquation(optimizeProgram(compileRPN(equationRPN(lhs, rhs))), env);
+}
+
+// drawn vertices within 1.5 px of the screen line x = sx (vertical) or y = sy, away from the origin
+static int verticesOnAxis(const std::vector<std::vector<sf::Vertex>>& lines, bool vertical) {
+    int count = 0;
+    for (const auto& line : lines) {
+        for (const sf::Vertex& v : line) {
+            float along = vertical ? v.position.y - 300.0f : v.position.x - 400.0f;
+            float across = vertical ? v.position.x - 400.0f : v.position.y - 300.0f;
+            count += std::fabs(across) <= 1.5f && std::fabs(along) >= 50.0f;
+        }
+    }
+    return count;
+}
+
+static std::vector<std::vector<sf::Vertex>> draw(const char* lhs, const char* rhs, const Env* env = nullptr) {
+    return computeGraphFromRPN(equationRPN(lhs, rhs), sf::Color::Cyan, 50.0, -8.0, 8.0, 400.0, 300.0, 800, 600, env);
+}
+
+TEST(equationZeroCoefficientFallsThrough) {
+    // y*0 = x has no y term at all: it is x = 0
+    SolvedEquation s = solve("y*0", "x");
+    CHECK(s.form == EquationForm::ExplicitX);
+    CHECK_CLOSE(evaluateProgram(s.function, 2.0, 0.0, nullptr), 0.0, 1e-15);
+    CHECK(verticesOnAxis(draw("y*0", "x"), true) > 0);
+
+    // the y terms cancel
+    s = solve("y-y+x", "0");
+    CHECK(s.form == EquationForm::ExplicitX);
+    CHECK_CLOSE(evaluateProgram(s.function, -3.0, 0.0, nullptr), 0.0, 1e-15);
+    CHECK(verticesOnAxis(draw("y-y+x", "0"), true) > 0);
+}
+
+TEST(equationCoefficientReadingTheOtherCoordinateStaysImplicit) {
+    // y = 0/x would lose the x = 0 half
+    SolvedEquation s = solve("x*y", "0");
+    CHECK(s.form == EquationForm::Implicit);
+    auto lines = draw("x*y", "0");
+    CHECK(verticesOnAxis(lines, true) > 0);
+    CHECK(verticesOnAxis(lines, false) > 0);
+}
+
+TEST(equationParameterCoefficientUsesEnv) {
+    Env env = { { "a", 2.0 } };
+    SolvedEquation s = solve("a*y", "x", &env);
+    CHECK(s.form == EquationForm::ExplicitY);
+    std::vector<double> vars = bindVariables(s.function, &env);
+    CHECK_CLOSE(evaluateProgram(s.function, 3.0, 0.0, vars.data()), 1.5, 1e-15);
+
+    // a = 0 turns it into x = 0, as does a missing a, which reads as 0
+    env["a"] = 0.0;
+    CHECK(solve("a*y", "x", &env).form == EquationForm::ExplicitX);
+    CHECK(verticesOnAxis(draw("a*y", "x", &env), true) > 0);
+    CHECK(solve("a*y", "x").form == EquationForm::ExplicitX);
+}
+
+TEST(equationLinearCasesStillSolve) {
+    SolvedEquation s = solve("2*y", "x+1");
+    CHECK(s.form == EquationForm::ExplicitY);
+    CHECK_CLOSE(evaluateProgram(s.function, 3.0, 0.0, nullptr), 2.0, 1e-15);
+    s = solve("x*3-y^2", "0");
+    CHECK(s.form == EquationForm::ExplicitX);
+    CHECK_CLOSE(evaluateProgram(s.function, 3.0, 0.0, nullptr), 3.0, 1e-15);
+    CHECK(solve("x^2+y^2", "25").form == EquationForm::Implicit);
+}
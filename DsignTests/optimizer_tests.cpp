@@ -0,0 +1,119 @@
+#include "check.h"
+#include "../DsignCalculator/core/evaluator/evaluator.h"
+#include "../DsignCalculator/core/optimizer/optimizer.h"
+#include "../DsignCalculator/core/parser/core_parser.h"
+#include "../DsignCalculator/core/tokenizer/tokenizer.h"
+#include <string>
+#include <unordered_map>
+
+// Each rewrite of optimizeProgram must take effect (checked on the opcodes it leaves behind) and
+// must not change what the expression computes: the optimized program is compared against the
+// unoptimized one over a grid of x, y that includes 0, negatives and values with no exact inverse.
+
+using Env = std::unordered_map<std::string, double>;
+
+static Program compileExpression(const char* e) {
+    return compileRPN(shuntingYard(tokenize(e)));
+}
+
+static int countOp(const Program& p, OpCode op) {
+    int c = 0;
+    for (const Instr& in : p.code) c += in.op == op;
+    return c;
+}
+
+// the optimized program of e, after checking it against the unoptimized one
+static Program checkOptimized(const char* e, const Env* env = nullptr, double tol = 1e-14) {
+    Program p = compileExpression(e);
+    Program q = optimizeProgram(p, env);
+    std::vector<double> pv = bindVariables(p, env), qv = bindVariables(q, env);
+    for (int i = -12; i <= 12; ++i) {
+        for (int j = -4; j <= 4; ++j) {
+            double x = i * 0.37, y = j * 1.3;
+            double expected = evaluateProgram(p, x, y, pv.data());
+            double actual = evaluateProgram(q, x, y, qv.data());
+            CHECK_CLOSE(actual, expected, tol);
+        }
+    }
+    return q;
+}
+
+TEST(optimizerFoldsConstants) {
+    Program q = checkOptimized("2*3+sin(0)+x");
+    CHECK(q.code.size() == 3);  // x, 6, +
+    q = checkOptimized("sqrt(16)/4");
+    CHECK(q.code.size() == 1 && q.code[0].op == OpCode::Const && q.code[0].value == 1.0);
+
+    // parameters bound in env fold like numbers, the others stay loads
+    Env env = { { "a", 2.0 } };
+    q = checkOptimized("a*b*x+a^2", &env);
+    CHECK(countOp(q, OpCode::LoadVar) == 1);
+    CHECK(countOp(q, OpCode::PowI) == 0);
+}
+
+TEST(optimizerReassociatesConstants) {
+    Program q = checkOptimized("x*2*pi");
+    CHECK(countOp(q, OpCode::Mul) == 1 && countOp(q, OpCode::Const) == 1);
+    q = checkOptimized("2*(x*pi)");
+    CHECK(countOp(q, OpCode::Mul) == 1);
+    q = checkOptimized("1+(x+2)+3");
+    CHECK(countOp(q, OpCode::Add) == 1);
+    // only the associative operators
+    q = checkOptimized("(x-2)-3");
+    CHECK(countOp(q, OpCode::Sub) == 2);
+}
+
+TEST(optimizerTurnsIntegerPowersIntoPowI) {
+    for (const char* e : { "x^2", "x^3", "x^7", "x^64", "x^-1", "x^-2", "x^-5", "(x+y)^4" }) {
+        Program q = checkOptimized(e, nullptr, 1e-13);
+        CHECK(countOp(q, OpCode::PowI) == 1 && countOp(q, OpCode::Pow) == 0);
+    }
+    // past MAX_POWI_EXPONENT, and non-integral exponents, std::pow stays
+    CHECK(countOp(checkOptimized("x^65"), OpCode::Pow) == 1);
+    CHECK(countOp(checkOptimized("x^2.5"), OpCode::Pow) == 1);
+    // x^0 and x^1
+    Program q = checkOptimized("x^0");
+    CHECK(q.code.size() == 1 && q.code[0].value == 1.0);
+    q = checkOptimized("x^1");
+    CHECK(q.code.size() == 1 && q.code[0].op == OpCode::LoadX);
+}
+
+TEST(optimizerDropsNegationUnderEvenPowers) {
+    Program q = checkOptimized("(-x)^2");
+    CHECK(countOp(q, OpCode::Neg) == 0 && countOp(q, OpCode::PowI) == 1);
+    q = checkOptimized("(-x)^-4");
+    CHECK(countOp(q, OpCode::Neg) == 0);
+    // odd powers keep the sign
+    q = checkOptimized("(-x)^3");
+    CHECK(countOp(q, OpCode::Neg) == 1);
+}
+
+TEST(optimizerDividesByReciprocal) {
+    for (const char* e : { "x/3", "x/10", "(x+y)/7", "x/0.1" }) {
+        Program q = checkOptimized(e, nullptr, 1e-15);
+        CHECK(countOp(q, OpCode::Div) == 0 && countOp(q, OpCode::Mul) == 1);
+    }
+    // division by 0, and by constants whose reciprocal is not a normal number, stays
+    CHECK(countOp(checkOptimized("x/0"), OpCode::Div) == 1);
+    CHECK(countOp(checkOptimized("x/10^-310"), OpCode::Div) == 1);
+}
+
+TEST(optimizerTurnsEPowerIntoExp) {
+    for (const char* e : { "e^x", "e^(x*y)", "e^-x" }) {
+        Program q = checkOptimized(e);
+        CHECK(countOp(q, OpCode::Exp) == 1 && countOp(q, OpCode::Pow) == 0);
+    }
+}
+
+TEST(optimizerDropsIdentities) {
+    for (const char* e : { "x+0", "0+x", "x-0", "x*1", "1*x", "-(-x)" }) {
+        Program q = checkOptimized(e);
+        CHECK(q.code.size() == 1 && q.code[0].op == OpCode::LoadX);
+    }
+    Program q = checkOptimized("0-x");
+    CHECK(q.code.size() == 2 && countOp(q, OpCode::Neg) == 1);
+    q = checkOptimized("abs(-x)");
+    CHECK(q.code.size() == 2 && countOp(q, OpCode::Abs) == 1);
+    q = checkOptimized("abs(abs(x-y))");
+    CHECK(countOp(q, OpCode::Abs) == 1);
+}
@@ -0,0 +1,134 @@
+#include "check.h"
+#include "../DsignCalculator/core/grapher/grapher.h"
+#include "../DsignCalculator/core/parser/core_parser.h"
+#include "../DsignCalculator/core/threading/stop_token.h"
+#include "../DsignCalculator/core/threading/thread_pool.h"
+#include "../DsignCalculator/core/tokenizer/tokenizer.h"
+#include <chrono>
+
+// ProgressiveGraph on an 800 x 600 screen at 50 px per unit, origin in the middle, for a curve and
+// for a relation plotted by each ImplicitMethod.
+
+static std::unique_ptr<ProgressiveGraph> makeGraph(const char* e, ImplicitMethod method, ThreadPool* pool,
+    double centerX = 400.0, double centerY = 300.0) {
+    return std::make_unique<ProgressiveGraph>(shuntingYard(tokenize(e)), sf::Color::Cyan, 50.0,
+        -centerX / 50.0, (800.0 - centerX) / 50.0, centerX, centerY, 800, 600, nullptr, pool, nullptr, method);
+}
+
+static bool refineToEnd(ProgressiveGraph& g) {
+    for (int pass = 0; pass < 16 && !g.done(); ++pass) g.refine(StopToken{});
+    return g.done();
+}
+
+// every strip has two or more finite vertices
+static bool wellFormed(const std::vector<std::vector<sf::Vertex>>& lines) {
+    for (const auto& line : lines) {
+        if (line.size() < 2) return false;
+        for (const sf::Vertex& v : line) {
+            if (!std::isfinite(v.position.x) || !std::isfinite(v.position.y)) return false;
+        }
+    }
+    return true;
+}
+
+static size_t vertexCount(const std::vector<std::vector<sf::Vertex>>& lines) {
+    size_t n = 0;
+    for (const auto& line : lines) n += line.size();
+    return n;
+}
+
+TEST(progressiveGraphStopsAndResumes) {
+    struct Case {
+        const char* expression;
+        ImplicitMethod method;
+    };
+    const Case cases[] = {
+        { "sin(x)*x", ImplicitMethod::Grid },  // sampled as a curve, the method is not used
+        { "sin(x*y)-0.3", ImplicitMethod::Grid },
+        { "sin(x*y)-0.3", ImplicitMethod::Quadtree },
+        { "sin(x*y)-0.3", ImplicitMethod::Trace },
+    };
+    ThreadPool pool(2);
+    std::atomic<bool> cancelled(true);
+    const StopToken stops[] = {
+        { &cancelled },
+        { nullptr, std::chrono::steady_clock::now() - std::chrono::seconds(1) },
+    };
+    for (const Case& c : cases) {
+        auto reference = makeGraph(c.expression, c.method, &pool);
+        CHECK(refineToEnd(*reference));
+        CHECK(!reference->segments().empty());
+
+        for (const StopToken& stop : stops) {
+            auto g = makeGraph(c.expression, c.method, &pool);
+            CHECK(!g->refine(stop));
+            CHECK(g->level() == 0 && !g->done());
+            CHECK(wellFormed(g->segments()));
+            // a second interruption leaves it as valid
+            CHECK(!g->refine(stop));
+            CHECK(wellFormed(g->segments()));
+
+            // and a fresh token finishes it as if it had never stopped
+            CHECK(refineToEnd(*g));
+            CHECK(wellFormed(g->segments()));
+            CHECK(g->segments().size() == reference->segments().size());
+            CHECK(vertexCount(g->segments()) == vertexCount(reference->segments()));
+        }
+    }
+}
+
+static bool sameValues(const std::vector<double>& a, const std::vector<double>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t k = 0; k < a.size(); ++k) {
+        if (!(a[k] == b[k] || (std::isnan(a[k]) && std::isnan(b[k])))) return false;
+    }
+    return true;
+}
+
+static bool samePolylines(const std::vector<std::vector<sf::Vertex>>& a, const std::vector<std::vector<sf::Vertex>>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t k = 0; k < a.size(); ++k) {
+        if (a[k].size() != b[k].size()) return false;
+        for (size_t m = 0; m < a[k].size(); ++m) {
+            if (a[k][m].position != b[k][m].position) return false;
+        }
+    }
+    return true;
+}
+
+TEST(progressiveGraphReusesPannedGrid) {
+    // grid nodes are 16/300 units (8/3 px) apart across and 0.04 units (2 px) down, so these pans
+    // move the grid by whole nodes, none of them a multiple of the coarse stride of 4
+    struct Pan {
+        double dx, dy;  // px
+    };
+    const Pan pans[] = {
+        { 8.0, 10.0 },     // 3 and 5 nodes
+        { -40.0, -14.0 },  // -15 and -7 nodes
+        { 0.0, 26.0 },     // whole rows exposed across the width
+        { -24.0, 0.0 },    // whole columns exposed down the height
+    };
+    const char* relations[] = { "sin(x*y)-0.3", "sin(x)+cos(y)-0.2" };
+    ThreadPool pool(2);
+    for (const char* e : relations) {
+        auto previous = makeGraph(e, ImplicitMethod::Grid, &pool);
+        CHECK(refineToEnd(*previous));
+        for (const Pan& pan : pans) {
+            double cx = 400.0 + pan.dx, cy = 300.0 + pan.dy;
+            auto panned = makeGraph(e, ImplicitMethod::Grid, &pool, cx, cy);
+            CHECK(panned->reuse(*previous));
+            // only the exposed strips are left, in one level
+            CHECK(panned->refine(StopToken{}) && panned->done());
+
+            auto fresh = makeGraph(e, ImplicitMethod::Grid, &pool, cx, cy);
+            CHECK(refineToEnd(*fresh));
+            CHECK(!fresh->gridValues().empty());
+            CHECK(sameValues(panned->gridValues(), fresh->gridValues()));
+            CHECK(samePolylines(panned->segments(), fresh->segments()));
+        }
+
+        // nothing is shared with a view panned past the whole grid
+        auto away = makeGraph(e, ImplicitMethod::Grid, &pool, 400.0 - 1600.0, 300.0);
+        CHECK(!away->reuse(*previous));
+    }
+}
@@ -0,0 +1,118 @@
+#include "check.h"
+#include "../DsignCalculator/core/grapher/sampler.h"
+#include "../DsignCalculator/core/grapher/tile_cache.h"
+#include "../DsignCalculator/core/optimizer/optimizer.h"
+#include "../DsignCalculator/core/parser/core_parser.h"
+#include "../DsignCalculator/core/tokenizer/tokenizer.h"
+
+// CurveSampler's evaluation budget, per tile and shared across the tiles of one curve, and the
+// tiles it seeds from the neighbouring zoom level.
+
+static Program compileCurve(const char* e) {
+    return optimizeProgram(compileRPN(shuntingYard(tokenize(e))));
+}
+
+// refines like ProgressiveGraph: a quarter-budget preview, then full passes until converged
+static void refineFully(CurveSampler& s) {
+    s.refine(TILE_SAMPLE_BUDGET / 4, nullptr);
+    for (int pass = 0; pass < 8 && !s.converged(); ++pass) s.refine(TILE_SAMPLE_BUDGET, nullptr);
+}
+
+TEST(curveSamplerCapsEvaluationsAcrossTiles) {
+    // a wide window at a fine scale spans MAX_TILES tiles, each of which would use its whole budget
+    CurveEvaluator f(compileCurve("sin(40*x)*x"), nullptr);
+    SampleWindow wide{ -1000.0, 1000.0, -INFINITY, INFINITY, 50.0 };
+    CurveSampler capped(f, wide);
+    refineFully(capped);
+    // the initial 4 px grid of a tile, at most 65 samples, is evaluated whatever its share
+    CHECK(capped.evaluations() <= CURVE_SAMPLE_BUDGET + 64 * 65);
+    CHECK(!capped.samples().empty());
+
+    CurveSampler tight(f, wide, nullptr, 4096);
+    refineFully(tight);
+    CHECK(tight.evaluations() <= 4096 + 64 * 65);
+}
+
+TEST(curveSamplerBudgetDoesNotBindOnAScreen) {
+    // a screen's handful of tiles converges as it would without the cap, and is cached
+    CurveEvaluator f(compileCurve("sin(x)*x^2"), nullptr);
+    SampleWindow screen{ -8.0, 8.0, -6.0, 6.0, 50.0 };
+    TileCache cache;
+    CurveSampler sampler(f, screen, &cache);
+    refineFully(sampler);
+    CHECK(sampler.converged());
+    CHECK(sampler.evaluations() < CURVE_SAMPLE_BUDGET);
+
+    CurveSampler again(f, screen, &cache);
+    CHECK(again.converged() && again.evaluations() == 0);
+    CHECK(again.samples().size() == sampler.samples().size());
+}
+
+// the largest distance, in px at ppu, between f and the chord of each pair of samples at its midpoint,
+// over the intervals with both ends within |v| <= 10, where float samples still resolve the curve
+static double maxChordDeviation(const CurveEvaluator& f, const std::vector<sf::Vector2f>& samples, double ppu) {
+    std::vector<double> ts, chords;
+    for (size_t i = 0; i + 1 < samples.size(); ++i) {
+        const sf::Vector2f& a = samples[i];
+        const sf::Vector2f& b = samples[i + 1];
+        if (!(std::fabs(a.y) <= 10.0f && std::fabs(b.y) <= 10.0f)) continue;
+        ts.push_back(0.5 * ((double)a.x + (double)b.x));
+        chords.push_back(0.5 * ((double)a.y + (double)b.y));
+    }
+    std::vector<double> vs(ts.size());
+    f.evaluate(ts.data(), vs.data(), ts.size());
+    double worst = 0.0;
+    for (size_t k = 0; k < ts.size(); ++k) worst = std::max(worst, std::fabs(vs[k] - chords[k]) * ppu);
+    return worst;
+}
+
+TEST(curveSamplerSeededTileMeetsTolerance) {
+    // zoom level 6 (64 px per unit), then one level in: the new tiles start from their parents
+    struct Case {
+        const char* expression;
+        double tMin, tMax;
+    };
+    const Case cases[] = { { "tan(x)", -4.0, 3.99 }, { "sin(1/x)", 0.25, 3.99 } };
+    for (const Case& c : cases) {
+        CurveEvaluator f(compileCurve(c.expression), nullptr);
+        TileCache cache;
+        CurveSampler outer(f, { c.tMin, c.tMax, -INFINITY, INFINITY, 64.0 }, &cache);
+        refineFully(outer);
+        CHECK(outer.converged());
+
+        SampleWindow zoomed{ c.tMin / 2.0, c.tMax / 2.0, -INFINITY, INFINITY, 128.0 };
+        CurveSampler seeded(f, zoomed, &cache);
+        refineFully(seeded);
+        CurveSampler fresh(f, zoomed);
+        refineFully(fresh);
+        CHECK(seeded.converged() && fresh.converged());
+        CHECK(seeded.evaluations() < fresh.evaluations());
+        CHECK(maxChordDeviation(f, fresh.samples(), 128.0) <= TOLERANCE_PX);
+        CHECK(maxChordDeviation(f, seeded.samples(), 128.0) <= TOLERANCE_PX);
+    }
+}
+
+TEST(curveSamplerZoomOutEvaluatesOnlyTheMargins) {
+    // tiles 0..3 of zoom level 7 (2 units wide) are the children of tiles 0 and 1 of level 6;
+    // zooming out to [-4, 12) adds the uncached tiles -1 and 2 around them
+    CurveEvaluator f(compileCurve("sin(3*x)*x"), nullptr);
+    TileCache cache;
+    CurveSampler inner(f, { 0.0, 7.99, -INFINITY, INFINITY, 128.0 }, &cache);
+    refineFully(inner);
+    CHECK(inner.converged());
+
+    CurveSampler outer(f, { -4.0, 11.99, -INFINITY, INFINITY, 64.0 }, &cache);
+    refineFully(outer);
+    CHECK(outer.converged());
+
+    // each margin on its own, with nothing cached
+    CurveSampler left(f, { -4.0, -0.01, -INFINITY, INFINITY, 64.0 });
+    CurveSampler right(f, { 8.0, 11.99, -INFINITY, INFINITY, 64.0 });
+    refineFully(left);
+    refineFully(right);
+    CHECK(outer.evaluations() == left.evaluations() + right.evaluations());
+
+    // and once all four are cached, nothing
+    CurveSampler again(f, { -4.0, 11.99, -INFINITY, INFINITY, 64.0 }, &cache);
+    CHECK(again.converged() && again.evaluations() == 0);
+}
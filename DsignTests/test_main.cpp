@@ -0,0 +1,27 @@
+#include "check.h"
+#include <cstring>
+
+std::vector<TestCase>& testRegistry() {
+    static std::vector<TestCase> tests;
+    return tests;
+}
+
+int& checkFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+// DsignTests [name-substring]: runs every test, or those whose name contains the argument
+int main(int argc, char** argv) {
+    int run = 0, failed = 0;
+    for (const TestCase& t : testRegistry()) {
+        if (argc > 1 && !std::strstr(t.name, argv[1])) continue;
+        int before = checkFailures();
+        std::printf("%s\n", t.name);
+        t.fn();
+        ++run;
+        if (checkFailures() != before) ++failed;
+    }
+    std::printf("%d tests, %d failed\n", run, failed);
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,205 @@
+#include "check.h"
+#include "../DsignCalculator/core/evaluator/vecmath.h"
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// The vectorized kernels against libm over their whole input domain: uniform samples of the fast
+// domain, log-uniform magnitudes from subnormals to DBL_MAX, and random bit patterns (NaN, inf,
+// subnormals included). Each implementation must stay within the bounds documented in vecmath.h:
+// vecSin & co. (the widest Ops of this build), and Pack<Sse2Ops> / Pack<Avx2Ops> directly. The
+// AVX2 packs are only compiled, and so only checked, in builds with AVX2 enabled.
+
+constexpr size_t SAMPLES = 1u << 18;  // per domain, a multiple of every lane count
+
+using Rng = std::mt19937_64;
+using UnaryFn = void (*)(const double*, double*, size_t);
+
+// distance in representable doubles; NaN only matches NaN
+static double ulpDistance(double a, double b) {
+    if (std::isnan(a) || std::isnan(b)) return std::isnan(a) && std::isnan(b) ? 0.0 : INFINITY;
+    if (a == b) return 0.0;
+    // map the bit patterns onto a line that is monotonic in the value, -0 and +0 both at 0
+    auto ordered = [](double v) {
+        int64_t i;
+        std::memcpy(&i, &v, sizeof i);
+        return i < 0 ? INT64_MIN - i : i;
+    };
+    int64_t ia = ordered(a), ib = ordered(b);
+    return (double)(ia > ib ? (uint64_t)ia - (uint64_t)ib : (uint64_t)ib - (uint64_t)ia);
+}
+
+static std::vector<double> uniform(Rng& rng, double lo, double hi) {
+    std::uniform_real_distribution<double> d(lo, hi);
+    std::vector<double> v(SAMPLES);
+    for (double& x : v) x = d(rng);
+    return v;
+}
+
+// sign * 2^e for e uniform in [minExp, maxExp]
+static std::vector<double> logUniform(Rng& rng, double minExp, double maxExp, bool bothSigns) {
+    std::uniform_real_distribution<double> e(minExp, maxExp);
+    std::vector<double> v(SAMPLES);
+    for (double& x : v) x = std::exp2(e(rng)) * (bothSigns && (rng() & 1) ? -1.0 : 1.0);
+    return v;
+}
+
+static std::vector<double> randomBits(Rng& rng) {
+    std::vector<double> v(SAMPLES);
+    for (double& x : v) {
+        uint64_t bits = rng();
+        std::memcpy(&x, &bits, sizeof x);
+    }
+    return v;
+}
+
+#ifdef VECMATH_SSE2
+template <class O, Pack<O> (*F)(Pack<O>)>
+static void packUnary(const double* in, double* out, size_t n) {
+    for (size_t i = 0; i < n; i += O::lanes) F(Pack<O>::load(in + i)).store(out + i);
+}
+#endif
+
+struct UnaryCase {
+    const char* name;
+    double (*ref)(double);
+    UnaryFn vec;
+    UnaryFn sse2;
+    UnaryFn avx2;
+    double bound;  // ULP
+    std::vector<std::vector<double>> (*inputs)(Rng&);
+};
+
+#if defined(VECMATH_AVX2)
+#define PACK_AVX2(f) &packUnary<Avx2Ops, f<Avx2Ops>>
+#else
+#define PACK_AVX2(f) nullptr
+#endif
+#if defined(VECMATH_SSE2)
+#define PACK_SSE2(f) &packUnary<Sse2Ops, f<Sse2Ops>>
+#else
+#define PACK_SSE2(f) nullptr
+#endif
+
+static std::vector<std::vector<double>> trigInputs(Rng& rng) {
+    return { uniform(rng, -10.0, 10.0), uniform(rng, -1e6, 1e6), logUniform(rng, -1074, 1024, true), randomBits(rng) };
+}
+static std::vector<std::vector<double>> expInputs(Rng& rng) {
+    return { uniform(rng, -708.0, 708.0), uniform(rng, -1.0, 1.0), logUniform(rng, -1074, 1024, true), randomBits(rng) };
+}
+static std::vector<std::vector<double>> logInputs(Rng& rng) {
+    return { uniform(rng, 0.5, 2.0), logUniform(rng, -1074, 1024, false), randomBits(rng) };
+}
+static std::vector<std::vector<double>> unitInputs(Rng& rng) {
+    std::vector<double> nearOne = logUniform(rng, -53, -1, false);
+    for (size_t i = 0; i < nearOne.size(); ++i) nearOne[i] = (i & 1 ? -1.0 : 1.0) * (1.0 - nearOne[i]);
+    return { uniform(rng, -1.0, 1.0), nearOne, logUniform(rng, -1074, 1, true), randomBits(rng) };
+}
+static std::vector<std::vector<double>> anyInputs(Rng& rng) {
+    return { uniform(rng, -4.0, 4.0), logUniform(rng, -1074, 1024, true), randomBits(rng) };
+}
+
+static double refSin(double x) { return std::sin(x); }
+static double refCos(double x) { return std::cos(x); }
+static double refTan(double x) { return std::tan(x); }
+static double refExp(double x) { return std::exp(x); }
+static double refLog(double x) { return std::log(x); }
+static double refAtan(double x) { return std::atan(x); }
+static double refAsin(double x) { return std::asin(x); }
+static double refAcos(double x) { return std::acos(x); }
+static double refSqrt(double x) { return std::sqrt(x); }
+static double refAbs(double x) { return std::fabs(x); }
+
+static const UnaryCase UNARY_CASES[] = {
+    { "sin", refSin, vecSin, PACK_SSE2(sin), PACK_AVX2(sin), 2, trigInputs },
+    { "cos", refCos, vecCos, PACK_SSE2(cos), PACK_AVX2(cos), 2, trigInputs },
+    { "tan", refTan, vecTan, PACK_SSE2(tan), PACK_AVX2(tan), 4, trigInputs },
+    { "exp", refExp, vecExp, PACK_SSE2(exp), PACK_AVX2(exp), 1, expInputs },
+    { "log", refLog, vecLog, PACK_SSE2(log), PACK_AVX2(log), 1, logInputs },
+    { "atan", refAtan, vecAtan, PACK_SSE2(atan), PACK_AVX2(atan), 1, anyInputs },
+    { "asin", refAsin, vecAsin, PACK_SSE2(asin), PACK_AVX2(asin), 2, unitInputs },
+    { "acos", refAcos, vecAcos, PACK_SSE2(acos), PACK_AVX2(acos), 2, unitInputs },
+    { "sqrt", refSqrt, vecSqrt, nullptr, nullptr, 0, anyInputs },
+    { "abs", refAbs, vecAbs, nullptr, nullptr, 0, anyInputs },
+};
+
+static double maxUnaryError(const UnaryCase& c, UnaryFn fn, const std::vector<std::vector<double>>& domains) {
+    double worst = 0.0;
+    std::vector<double> out(SAMPLES);
+    for (const auto& in : domains) {
+        fn(in.data(), out.data(), in.size());
+        for (size_t i = 0; i < in.size(); ++i) worst = std::fmax(worst, ulpDistance(out[i], c.ref(in[i])));
+    }
+    return worst;
+}
+
+TEST(vecmathUnaryMatchesLibm) {
+    Rng rng(20240601);
+    std::printf("  %-5s %6s %8s %8s %8s\n", "fn", "bound", "vec", "sse2", "avx2");
+    for (const UnaryCase& c : UNARY_CASES) {
+        auto domains = c.inputs(rng);
+        double errors[3] = { NAN, NAN, NAN };
+        UnaryFn fns[3] = { c.vec, c.sse2, c.avx2 };
+        for (int k = 0; k < 3; ++k) {
+            if (!fns[k]) continue;
+            errors[k] = maxUnaryError(c, fns[k], domains);
+            CHECK(errors[k] <= c.bound);
+        }
+        std::printf("  %-5s %6g %8g %8g %8g\n", c.name, c.bound, errors[0], errors[1], errors[2]);
+    }
+}
+
+#ifdef VECMATH_SSE2
+template <class O>
+static void packPow(const double* a, const double* b, double* out, size_t n) {
+    for (size_t i = 0; i < n; i += O::lanes) pow(Pack<O>::load(a + i), Pack<O>::load(b + i)).store(out + i);
+}
+#endif
+
+// pow loses accuracy with |b ln a|, as the rounding error of the log is scaled by b before exp:
+// the bound is 2 * (1 + |b ln a|) ULP, about 1400 ULP as |b ln a| nears 708
+TEST(vecmathPowMatchesLibm) {
+    Rng rng(20240602);
+    std::vector<std::vector<double>> as, bs;
+    // |b ln a| spread evenly over the fast domain
+    std::vector<double> a = logUniform(rng, -1022, 1023, false), t = uniform(rng, -708.0, 708.0), b(SAMPLES);
+    for (size_t i = 0; i < SAMPLES; ++i) b[i] = std::log(a[i]) != 0.0 ? t[i] / std::log(a[i]) : t[i];
+    as.push_back(a); bs.push_back(b);
+    as.push_back(uniform(rng, 0.0, 10.0)); bs.push_back(uniform(rng, -20.0, 20.0));
+    // negative bases with integral exponents, and anything at all
+    std::vector<double> n = uniform(rng, -10.0, 0.0), k = uniform(rng, -30.0, 30.0);
+    for (double& e : k) e = std::round(e);
+    as.push_back(n); bs.push_back(k);
+    as.push_back(randomBits(rng)); bs.push_back(randomBits(rng));
+
+    using BinaryFn = void (*)(const double*, const double*, double*, size_t);
+    BinaryFn fns[3] = { vecPow, nullptr, nullptr };
+#ifdef VECMATH_SSE2
+    fns[1] = packPow<Sse2Ops>;
+#endif
+#ifdef VECMATH_AVX2
+    fns[2] = packPow<Avx2Ops>;
+#endif
+    std::vector<double> out(SAMPLES);
+    std::printf("  %-5s %8s %8s %8s   (max ULP, then max ULP / (1 + |b ln a|))\n", "fn", "vec", "sse2", "avx2");
+    double worst[3] = { NAN, NAN, NAN }, relative[3] = { NAN, NAN, NAN };
+    for (int f = 0; f < 3; ++f) {
+        if (!fns[f]) continue;
+        worst[f] = relative[f] = 0.0;
+        for (size_t d = 0; d < as.size(); ++d) {
+            fns[f](as[d].data(), bs[d].data(), out.data(), SAMPLES);
+            for (size_t i = 0; i < SAMPLES; ++i) {
+                double ref = std::pow(as[d][i], bs[d][i]);
+                double err = ulpDistance(out[i], ref);
+                double scale = 1.0 + std::fabs(bs[d][i] * std::log(as[d][i]));
+                if (!std::isfinite(scale)) scale = 1.0;
+                worst[f] = std::fmax(worst[f], err);
+                relative[f] = std::fmax(relative[f], err / scale);
+            }
+        }
+        CHECK(relative[f] <= 2.0);
+    }
+    std::printf("  %-5s %8g %8g %8g\n", "pow", worst[0], worst[1], worst[2]);
+    std::printf("  %-5s %8.3g %8.3g %8.3g\n", "", relative[0], relative[1], relative[2]);
+}